@@ -1,5 +1,20 @@
 #include "Redis.h"
 #include "RedisInternal.h"
+#include "RedisClientCache.h"
+#include <limits.h>
+
+Redis::Redis(Client &client) : conn(client), reader(new RedisReader(client))
+{
+  reader->setPushHandler(_routePush, this);
+  reader->setPendingHandler(_waitPending, this);
+}
+
+Redis::~Redis() {}
+
+void Redis::setReplyArena(bool enabled)
+{
+  reader->parser().setArena(enabled);
+}
 
 RedisReturnValue Redis::authenticate(const char *password)
 {
@@ -8,7 +23,11 @@ RedisReturnValue Redis::authenticate(const char *password)
     int passwordLength = strlen(password);
     if (passwordLength > 0)
     {
-      auto cmdRet = RedisCommand("AUTH", ArgList{password}).issue(conn);
+      auto cmdRet = RedisCommand::issue(*reader, {"AUTH", password});
+      if (cmdRet->type() == RedisObject::Type::InternalError)
+      {
+        return RedisNotConnectedFailure;
+      }
       return cmdRet->type() == RedisObject::Type::SimpleString && (String)*cmdRet == "OK"
                  ? RedisSuccess
                  : RedisAuthFailure;
@@ -20,18 +39,384 @@ RedisReturnValue Redis::authenticate(const char *password)
   return RedisNotConnectedFailure;
 }
 
-#define TRCMD(t, c, ...) return RedisCommand(c, ArgList{__VA_ARGS__}).issue_typed<t>(conn)
+bool Redis::hello(int protocolVersion)
+{
+  // the server's properties: a map under RESP3, an array under RESP2
+  auto rv = RedisCommand::issue(*reader, {"HELLO", protocolVersion});
+  if (rv->type() != RedisObject::Type::Array)
+  {
+    return false;
+  }
+
+  resp3 = protocolVersion == 3;
+  return true;
+}
+
+static bool isOK(const std::shared_ptr<RedisObject> &reply)
+{
+  return reply->type() == RedisObject::Type::SimpleString && (String)*reply == "OK";
+}
+
+bool Redis::enableClientCache(RedisClientCache &clientCache)
+{
+  // under RESP2 the server would track keys but have no way to send their invalidations on this connection
+  if (!resp3 || !isOK(RedisCommand::issue(*reader, {"CLIENT", "TRACKING", "ON"})))
+  {
+    return false;
+  }
+
+  cache = invalidatedCache = &clientCache;
+  return true;
+}
+
+bool Redis::enableClientCache(RedisClientCache &clientCache, Redis &invalidations)
+{
+  auto id = RedisCommand::issue(*invalidations.reader, {"CLIENT", "ID"});
+  if (id->type() != RedisObject::Type::Integer ||
+      !isOK(RedisCommand::issue(*reader, {"CLIENT", "TRACKING", "ON", "REDIRECT", (String)*id})))
+  {
+    return false;
+  }
+
+  cache = &clientCache;
+  redirectedTo = &invalidations;
+  invalidations.invalidatedCache = &clientCache;
+  invalidations.redirectedFrom = this;
+  invalidations.subscribe("__redis__:invalidate");
+  return true;
+}
+
+void Redis::disableClientCache()
+{
+  if (!cache)
+  {
+    return;
+  }
+
+  RedisCommand::issue(*reader, {"CLIENT", "TRACKING", "OFF"});
+  if (invalidatedCache == cache)
+  {
+    invalidatedCache = nullptr;
+  }
+  cache = nullptr;
+  _endRedirect();
+}
+
+// Stop the connection this redirects its invalidations to from applying them to the cache, or listening for them
+void Redis::_endRedirect()
+{
+  if (!redirectedTo)
+  {
+    return;
+  }
+
+  redirectedTo->invalidatedCache = nullptr;
+  redirectedTo->redirectedFrom = nullptr;
+  redirectedTo->unsubscribe("__redis__:invalidate");
+  redirectedTo = nullptr;
+}
+
+// Bring a new connection to the state of the one lost, in the order the server requires: authenticated,
+// in the same protocol and database, caching and subscribed as before
+RedisReturnValue Redis::_restore(const char *password, int database)
+{
+  reader->reset();
+
+  // the replies outstanding on the connection lost will never arrive, and the next read must be of AUTH's
+  std::shared_ptr<RedisObject> lost(new RedisInternalError(RedisInternalError::Disconnected));
+  while (pendingReplies.size())
+  {
+    _complete(lost);
+  }
+
+  auto authenticated = password && *password ? authenticate(password) : RedisSuccess;
+  if (authenticated != RedisSuccess)
+  {
+    return authenticated;
+  }
+
+  if (resp3 && !hello(3))
+  {
+    return RedisNotConnectedFailure;
+  }
+
+  if (database && !isOK(RedisCommand::issue(*reader, {"SELECT", database})))
+  {
+    return RedisNotConnectedFailure;
+  }
+
+  // the server has forgotten which keys it was tracking, so anything cached may be stale; tracking can be
+  // turned back on here only if its invalidations come here too, as the redirect target's ID is no longer known
+  if (redirectedFrom)
+  {
+    redirectedFrom->cache = nullptr;
+    redirectedFrom->redirectedTo = nullptr;
+    redirectedFrom = nullptr;
+
+    // not to be resubscribed to below: nothing is redirected here any more
+    for (auto it = subSpec.begin(); it != subSpec.end(); ++it)
+    {
+      if (it->kind == SubscribeChannel && it->spec == "__redis__:invalidate")
+      {
+        subSpec.erase(it);
+        break;
+      }
+    }
+  }
+
+  if (cache || invalidatedCache)
+  {
+    (cache ? cache : invalidatedCache)->clear();
+    auto tracking = cache && cache == invalidatedCache;
+    if (!tracking || !isOK(RedisCommand::issue(*reader, {"CLIENT", "TRACKING", "ON"})))
+    {
+      cache = invalidatedCache = nullptr;
+      _endRedirect();
+    }
+  }
+
+  if (subscriberMode && subLoopRun && (subMsgCallback || subMsgViewCallback))
+  {
+    // kept for the next attempt should this one fail, as a failed setup drops them
+    auto msgCallback = subMsgCallback;
+    auto msgViewCallback = subMsgViewCallback;
+    if (_beginSubscribing(subErrCallback) != RedisSubscribeSuccess)
+    {
+      subMsgCallback = msgCallback;
+      subMsgViewCallback = msgViewCallback;
+      subscriberMode = subLoopRun = true;
+      return RedisNotConnectedFailure;
+    }
+  }
+  return RedisSuccess;
+}
+
+bool Redis::_issueAsync(std::initializer_list<RedisArg> cmdAndArgs, RedisReplyCallback callback, void *context)
+{
+  if (!conn.connected())
+  {
+    return false;
+  }
+
+  RedisEncoder(conn).command(cmdAndArgs);
+  pendingReplies.push_back({callback, context});
+  return true;
+}
+
+bool Redis::issueAsync(const String &command, const std::vector<String> &args, RedisReplyCallback callback, void *context)
+{
+  if (!conn.connected())
+  {
+    return false;
+  }
+
+  RedisEncoder(conn).command(command, args);
+  pendingReplies.push_back({callback, context});
+  return true;
+}
+
+bool Redis::getAsync(const char *key, RedisReplyCallback callback, void *context)
+{
+  return _issueAsync({"GET", key}, callback, context);
+}
+
+bool Redis::setAsync(const char *key, const char *value, RedisReplyCallback callback, void *context)
+{
+  return _issueAsync({"SET", key, value}, callback, context);
+}
+
+bool Redis::publishAsync(const char *channel, const char *message, RedisReplyCallback callback, void *context)
+{
+  return _issueAsync({"PUBLISH", channel, message}, callback, context);
+}
+
+void Redis::_complete(std::shared_ptr<RedisObject> reply)
+{
+  // taken off the queue first, so that the callback may issue commands of its own
+  auto pending = pendingReplies.front();
+  pendingReplies.pop_front();
+  if (pending.callback)
+  {
+    pending.callback(this, reply, pending.context);
+  }
+}
+
+size_t Redis::poll()
+{
+  size_t completed = 0;
+  // only parse once bytes have arrived, so an idle poll costs no more than a call to available()
+  while (pendingReplies.size() && (reader->available() > 0 || reader->parser().inProgress()))
+  {
+    auto reply = RedisObject::parseTypeNonBlocking(*reader);
+    if (!reply)
+    {
+      // the rest of this reply is yet to arrive
+      break;
+    }
+
+    _complete(reply);
+    completed++;
+  }
+
+  if (pendingReplies.size() && !reader->connected())
+  {
+    std::shared_ptr<RedisObject> lost(new RedisInternalError(RedisInternalError::Disconnected));
+    for (; pendingReplies.size(); completed++)
+    {
+      _complete(lost);
+    }
+  }
+  return completed;
+}
+
+void Redis::wait()
+{
+  while (pendingReplies.size())
+  {
+    auto reply = RedisObject::parseType(*reader);
+    _complete(reply);
+
+    // once a reply has timed out or the connection is lost, no later one can be told apart from it
+    while (reply->type() == RedisObject::Type::InternalError &&
+           ((RedisInternalError *)reply.get())->code() != RedisInternalError::MalformedReply && pendingReplies.size())
+    {
+      _complete(reply);
+    }
+  }
+}
+
+void Redis::_waitPending(void *context)
+{
+  ((Redis *)context)->wait();
+}
+
+String Redis::_cachedGet(const char *key, const char *field)
+{
+  String value;
+  if (cache && cache->lookup(key, field, value))
+  {
+    return value;
+  }
+
+  // an invalidation may be applied while the reply is awaited (and the cache disabled, on reconnection)
+  auto reserved = cache;
+  if (reserved)
+  {
+    reserved->reserve(key, field);
+  }
+
+  auto reply = field ? RedisCommand::issue(*reader, {"HGET", key, field}) : RedisCommand::issue(*reader, {"GET", key});
+  // neither errors nor missing keys are cached: the server tracks only keys that exist
+  if (reserved && reply->type() == RedisObject::Type::BulkString && !((RedisBulkString *)reply.get())->isNilReturn())
+  {
+    reserved->fill((String)*reply);
+  }
+  else if (reserved)
+  {
+    reserved->release();
+  }
+  return RedisCommand::convert_typed<String>(reply);
+}
+
+#define TRCMD(t, c, ...) return RedisCommand::issue_typed<t>(*reader, {c, __VA_ARGS__})
 
-#define TRCMD_EXPECTOK(c, ...) return (bool)(((String)*RedisCommand(c, ArgList{__VA_ARGS__}).issue(conn)).indexOf("OK") != -1)
+#define TRCMD_EXPECTOK(c, ...) return (bool)(((String)*RedisCommand::issue(*reader, {c, __VA_ARGS__})).indexOf("OK") != -1)
 
 bool Redis::set(const char *key, const char *value)
 {
   TRCMD_EXPECTOK("SET", key, value);
 }
 
+bool Redis::set(const char *key, const uint8_t *value, size_t len)
+{
+  TRCMD_EXPECTOK("SET", key, RedisArg(value, len));
+}
+
 String Redis::get(const char *key)
 {
-  TRCMD(String, "GET", key);
+  return _cachedGet(key, nullptr);
+}
+
+int Redis::get(const char *key, uint8_t *buf, size_t cap)
+{
+  reader->parser().setBulkTarget(buf, cap);
+  auto reply = RedisCommand::issue(*reader, {"GET", key});
+  reader->parser().setBulkTarget(nullptr, 0);
+
+  if (reply->type() != RedisObject::Type::BulkString)
+  {
+    return -2;
+  }
+
+  auto bulk = (RedisBulkString *)reply.get();
+  if (bulk->isNilReturn())
+  {
+    return -1;
+  }
+
+  if (bulk->bytes() != buf)
+  {
+    memcpy(buf, bulk->bytes(), bulk->length() < cap ? bulk->length() : cap);
+  }
+  return bulk->length();
+}
+
+// The elements of an array reply as Strings, in the manner of the other array-returning methods
+static std::vector<String> toStrings(std::shared_ptr<RedisObject> rv)
+{
+  if (rv->type() == RedisObject::Type::InternalError)
+  {
+    std::vector<String> r = std::vector<String>();
+    String error_message = (String)(((RedisInternalError *)rv.get())->RESP());
+    r.push_back(error_message);
+    return r;
+  }
+  else
+  {
+    return rv->type() == RedisObject::Type::Array
+               ? (std::vector<String>)*((RedisArray *)rv.get())
+               : std::vector<String>();
+  }
+}
+
+// A double (a score, or an increment) as an argument, in as few digits as read back as the same double
+static String doubleArg(double value)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.15g", value);
+  if (strtod(buf, nullptr) != value)
+  {
+    snprintf(buf, sizeof(buf), "%.17g", value);
+  }
+  return String(buf);
+}
+
+// `prefix` followed by each pair's two strings in turn
+static ArgList pairArgs(const char *prefix, const std::vector<std::pair<String, String>> &pairs)
+{
+  ArgList argList;
+  argList.reserve(pairs.size() * 2 + 1);
+  if (prefix)
+  {
+    argList.push_back(prefix);
+  }
+
+  for (auto &pair : pairs)
+  {
+    argList.push_back(pair.first);
+    argList.push_back(pair.second);
+  }
+  return argList;
+}
+
+std::vector<String> Redis::mget(const std::vector<String> &keys)
+{
+  return toStrings(RedisCommand::issue(*reader, "MGET", keys));
+}
+
+bool Redis::mset(const std::vector<std::pair<String, String>> &keysAndValues)
+{
+  return RedisCommand::convert_typed<String>(RedisCommand::issue(*reader, "MSET", pairArgs(nullptr, keysAndValues))) == "OK";
 }
 
 bool Redis::del(const char *key)
@@ -39,24 +424,58 @@ bool Redis::del(const char *key)
   TRCMD(bool, "DEL", key);
 }
 
+int Redis::del(const std::vector<String> &keys)
+{
+  return RedisCommand::convert_typed<int>(RedisCommand::issue(*reader, "DEL", keys));
+}
+
+int Redis::unlink(const std::vector<String> &keys)
+{
+  return RedisCommand::convert_typed<int>(RedisCommand::issue(*reader, "UNLINK", keys));
+}
+
 int Redis::append(const char *key, const char *value)
 {
   TRCMD(int, "APPEND", key, value);
 }
 
+RedisResult<int64_t> Redis::incr(const char *key, int64_t increment)
+{
+  if (increment == 1)
+  {
+    return RedisCommand::issue_result<int64_t>(*reader, {"INCR", key});
+  }
+  return RedisCommand::issue_result<int64_t>(*reader, {"INCRBY", key, (long long)increment});
+}
+
+RedisResult<double> Redis::incrbyfloat(const char *key, double increment)
+{
+  return RedisCommand::issue_result<double>(*reader, {"INCRBYFLOAT", key, doubleArg(increment)});
+}
+
 int Redis::publish(const char *channel, const char *message)
 {
   TRCMD(int, "PUBLISH", channel, message);
 }
 
+int Redis::spublish(const char *shardChannel, const char *message)
+{
+  TRCMD(int, "SPUBLISH", shardChannel, message);
+}
+
 bool Redis::exists(const char *key)
 {
   TRCMD(bool, "EXISTS", key);
 }
 
+int Redis::exists(const std::vector<String> &keys)
+{
+  return RedisCommand::convert_typed<int>(RedisCommand::issue(*reader, "EXISTS", keys));
+}
+
 bool Redis::_expire_(const char *key, int arg, const char *cmd_var)
 {
-  TRCMD(bool, cmd_var, key, String(arg));
+  TRCMD(bool, cmd_var, key, arg);
 }
 
 bool Redis::persist(const char *key)
@@ -69,14 +488,37 @@ int Redis::_ttl_(const char *key, const char *cmd_var)
   TRCMD(int, cmd_var, key);
 }
 
+int64_t Redis::pttl(const char *key)
+{
+  auto result = pttlResult(key);
+  return result.ok() ? result.value : INT_MAX - 0xf0;
+}
+
+RedisResult<int64_t> Redis::pttlResult(const char *key)
+{
+  return RedisCommand::issue_result<int64_t>(*reader, {"PTTL", key});
+}
+
 bool Redis::_hset_(const char *key, const char *field, const char *value, const char *cmd_var)
 {
   TRCMD(int, cmd_var, key, field, value);
 }
 
+int Redis::hset(const char *key, const std::vector<std::pair<String, String>> &fieldsAndValues)
+{
+  return RedisCommand::convert_typed<int>(RedisCommand::issue(*reader, "HSET", pairArgs(key, fieldsAndValues)));
+}
+
 String Redis::hget(const char *key, const char *field)
 {
-  TRCMD(String, "HGET", key, field);
+  return _cachedGet(key, field);
+}
+
+std::vector<String> Redis::hmget(const char *key, const std::vector<String> &fields)
+{
+  ArgList argList = ArgList{key};
+  argList.insert(argList.end(), fields.begin(), fields.end());
+  return toStrings(RedisCommand::issue(*reader, "HMGET", argList));
 }
 
 bool Redis::hdel(const char *key, const char *field)
@@ -101,7 +543,7 @@ bool Redis::hexists(const char *key, const char *field)
 
 std::vector<String> Redis::lrange(const char *key, int start, int stop)
 {
-  auto rv = RedisCommand("LRANGE", ArgList{key, String(start), String(stop)}).issue(conn);
+  auto rv = RedisCommand::issue(*reader, {"LRANGE", key, start, stop});
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -118,9 +560,15 @@ std::vector<String> Redis::lrange(const char *key, int start, int stop)
   }
 }
 
+int Redis::lrange(const char *key, int start, int stop, RedisVisitor &visitor)
+{
+  auto rv = RedisCommand::issue(*reader, {"LRANGE", key, start, stop}, visitor);
+  return rv->type() == RedisObject::Type::Array ? ((String)*rv).toInt() : -1;
+}
+
 String Redis::lindex(const char *key, int index)
 {
-  TRCMD(String, "LINDEX", key, String(index));
+  TRCMD(String, "LINDEX", key, index);
 }
 
 int Redis::llen(const char *key)
@@ -145,28 +593,28 @@ int Redis::lpush(const char *key, const char *value, bool exclusive)
 
 int Redis::lrem(const char *key, int count, const char *element)
 {
-  TRCMD(int, "LREM", key, String(count), element);
+  TRCMD(int, "LREM", key, count, element);
 }
 
 bool Redis::lset(const char *key, int index, const char *element)
 {
-  TRCMD_EXPECTOK("LSET", key, String(index), element);
+  TRCMD_EXPECTOK("LSET", key, index, element);
 }
 
 bool Redis::ltrim(const char *key, int start, int stop)
 {
-  TRCMD_EXPECTOK("LTRIM", key, String(start), String(stop));
+  TRCMD_EXPECTOK("LTRIM", key, start, stop);
 }
 
 bool Redis::tsadd(const char *key, long timestamp, const int value)
 {
   if (timestamp < 0)
   {
-    TRCMD_EXPECTOK("TS.ADD", key, "*", String(value));
+    TRCMD_EXPECTOK("TS.ADD", key, "*", value);
   }
   else
   {
-    TRCMD_EXPECTOK("TS.ADD", key, String(timestamp) + "000", String(value));
+    TRCMD_EXPECTOK("TS.ADD", key, String(timestamp) + "000", value);
   }
 }
 
@@ -181,6 +629,12 @@ String Redis::xadd(const char *key, const char *id, const char *field,
   TRCMD(String, "XADD", key, id, field, value);
 }
 
+String Redis::xadd(const char *key, const char *id, const char *field,
+                   const uint8_t *value, size_t len)
+{
+  TRCMD(String, "XADD", key, id, field, RedisArg(value, len));
+}
+
 std::vector<String> Redis::xautoclaim(const char *key, const char *group,
                                       const char *consumer, unsigned int min_idle_time, const char *start,
                                       unsigned int count, bool justid)
@@ -198,7 +652,7 @@ std::vector<String> Redis::xautoclaim(const char *key, const char *group,
     argList.push_back("JUSTID");
   }
 
-  auto rv = RedisCommand("XAUTOCLAIM", argList).issue(conn);
+  auto rv = RedisCommand::issue(*reader, "XAUTOCLAIM", argList);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -256,7 +710,7 @@ std::vector<String> Redis::xclaim(const char *key, const char *group,
     argList.push_back(lastid);
   }
 
-  auto rv = RedisCommand("XCLAIM", argList).issue(conn);
+  auto rv = RedisCommand::issue(*reader, "XCLAIM", argList);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -315,7 +769,7 @@ bool Redis::xgroup_setid(const char *key, const char *group, const char *id)
 
 std::vector<String> Redis::xinfo_consumers(const char *key, const char *group)
 {
-  auto rv = RedisCommand("XINFO", ArgList{"CONSUMERS", key, group}).issue(conn);
+  auto rv = RedisCommand::issue(*reader, {"XINFO", "CONSUMERS", key, group});
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -334,7 +788,7 @@ std::vector<String> Redis::xinfo_consumers(const char *key, const char *group)
 
 std::vector<String> Redis::xinfo_groups(const char *key)
 {
-  auto rv = RedisCommand("XINFO", ArgList{"GROUPS", key}).issue(conn);
+  auto rv = RedisCommand::issue(*reader, {"XINFO", "GROUPS", key});
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -367,7 +821,7 @@ std::vector<String> Redis::xinfo_stream(const char *key, bool full,
     }
   }
 
-  auto rv = RedisCommand("XINFO", argList).issue(conn);
+  auto rv = RedisCommand::issue(*reader, "XINFO", argList);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -413,7 +867,7 @@ std::vector<String> Redis::xpending(const char *key, const char *group,
     argList.push_back(consumer);
   }
 
-  auto rv = RedisCommand("XPENDING", argList).issue(conn);
+  auto rv = RedisCommand::issue(*reader, "XPENDING", argList);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -430,36 +884,185 @@ std::vector<String> Redis::xpending(const char *key, const char *group,
   }
 }
 
-std::vector<String> Redis::xrange(const char *key, const char *start,
-                                  const char *end, unsigned int count)
+// The depth within an XRANGE/XREVRANGE reply at which each entry sits: [entry, ...]
+#define RangeEntryDepth 1
+// ... and within an XREAD/XREADGROUP reply: [[key, [entry, ...]], ...]; or under RESP3, {key: [entry, ...], ...}
+#define ReadEntryDepth(resp3) ((resp3) ? 2 : 3)
+
+// The element at `index` of `array`, or `nullptr` if it is not an array or is too short
+static std::shared_ptr<RedisObject> elementAt(const std::shared_ptr<RedisObject> &array, size_t index)
 {
-  ArgList argList = ArgList{key, start, end};
+  return array && array->type() == RedisObject::Type::Array ? ((RedisArray *)array.get())->at(index) : nullptr;
+}
 
-  if (count > 0)
-  {
-    argList.push_back("COUNT");
-    argList.push_back(String(count));
-  }
+static size_t sizeOf(const std::shared_ptr<RedisObject> &array)
+{
+  return array && array->type() == RedisObject::Type::Array ? ((RedisArray *)array.get())->size() : 0;
+}
 
-  auto rv = RedisCommand("XRANGE", argList).issue(conn);
+static String stringOf(const std::shared_ptr<RedisObject> &obj)
+{
+  return obj ? (String)*obj : String("(nil)");
+}
 
-  if (rv->type() == RedisObject::Type::InternalError)
-  {
-    std::vector<String> r = std::vector<String>();
-    String error_message = (String)(((RedisInternalError *)rv.get())->RESP());
-    r.push_back(error_message);
-    return r;
-  }
-  else
-  {
-    return rv->type() == RedisObject::Type::Array
-               ? (std::vector<String>)*((RedisArray *)rv.get())
-               : std::vector<String>();
-  }
+String RedisStreamEntry::id() const
+{
+  return stringOf(elementAt(entry, 0));
 }
 
-std::vector<String> Redis::xread(unsigned int count, unsigned int block,
-                                 const char *key, const char *id)
+size_t RedisStreamEntry::size() const
+{
+  return sizeOf(elementAt(entry, 1)) / 2;
+}
+
+String RedisStreamEntry::field(size_t index) const
+{
+  return stringOf(elementAt(elementAt(entry, 1), index * 2));
+}
+
+String RedisStreamEntry::value(size_t index) const
+{
+  return stringOf(elementAt(elementAt(entry, 1), index * 2 + 1));
+}
+
+String RedisStreamEntry::value(const String &field) const
+{
+  auto fields = elementAt(entry, 1);
+  for (size_t i = 0; i + 1 < sizeOf(fields); i += 2)
+  {
+    if (stringOf(elementAt(fields, i)) == field)
+    {
+      return stringOf(elementAt(fields, i + 1));
+    }
+  }
+  return String("(nil)");
+}
+
+RedisStreamEntries::RedisStreamEntries(std::shared_ptr<RedisObject> reply, bool perStream) : reply(reply)
+{
+  if (!perStream)
+  {
+    entries = reply;
+  }
+  else if (reply && reply->wireType() == RedisObject::Type::Map)
+  {
+    // RESP3's {key: [entry, ...]}, flattened to [key, [entry, ...]]
+    entries = elementAt(reply, 1);
+  }
+  else
+  {
+    entries = elementAt(elementAt(reply, 0), 1);
+  }
+}
+
+size_t RedisStreamEntries::size() const
+{
+  return sizeOf(entries);
+}
+
+RedisStreamEntry RedisStreamEntries::operator[](size_t index) const
+{
+  return RedisStreamEntry(elementAt(entries, index));
+}
+
+bool RedisStreamEntries::isError() const
+{
+  return reply && (reply->type() == RedisObject::Type::Error || reply->type() == RedisObject::Type::InternalError);
+}
+
+String RedisStreamEntries::error() const
+{
+  return isError() ? (String)*reply : String("");
+}
+
+// Delivers each entry of a streamed reply to a RedisStreamEntryCallback as the parser completes it
+class StreamEntrySink
+{
+public:
+  StreamEntrySink(Redis *redis, Redis::RedisStreamEntryCallback callback, RedisReader &reader, size_t depth)
+      : redis(redis), callback(callback), reader(reader)
+  {
+    reader.parser().setElementSink(depth, deliver, this);
+  }
+
+  ~StreamEntrySink() { reader.parser().setElementSink(0, nullptr, nullptr); }
+
+  /** @return The number of entries delivered, or -1 if `reply` is an error */
+  int finish(std::shared_ptr<RedisObject> reply)
+  {
+    if (reply->type() == RedisObject::Type::Error || reply->type() == RedisObject::Type::InternalError)
+    {
+      return -1;
+    }
+    return count;
+  }
+
+private:
+  static void deliver(std::shared_ptr<RedisObject> element, void *context)
+  {
+    auto sink = (StreamEntrySink *)context;
+    sink->count++;
+    if (sink->callback)
+    {
+      sink->callback(sink->redis, RedisStreamEntry(element));
+    }
+  }
+
+  Redis *redis;
+  Redis::RedisStreamEntryCallback callback;
+  RedisReader &reader;
+  int count = 0;
+};
+
+std::shared_ptr<RedisObject> Redis::_xrange_(const char *cmd, const char *key, const char *from,
+                                             const char *to, unsigned int count)
+{
+  ArgList argList = ArgList{key, from, to};
+
+  if (count > 0)
+  {
+    argList.push_back("COUNT");
+    argList.push_back(String(count));
+  }
+
+  return RedisCommand::issue(*reader, cmd, argList);
+}
+
+std::vector<String> Redis::xrange(const char *key, const char *start,
+                                  const char *end, unsigned int count)
+{
+  auto rv = _xrange_("XRANGE", key, start, end, count);
+
+  if (rv->type() == RedisObject::Type::InternalError)
+  {
+    std::vector<String> r = std::vector<String>();
+    String error_message = (String)(((RedisInternalError *)rv.get())->RESP());
+    r.push_back(error_message);
+    return r;
+  }
+  else
+  {
+    return rv->type() == RedisObject::Type::Array
+               ? (std::vector<String>)*((RedisArray *)rv.get())
+               : std::vector<String>();
+  }
+}
+
+RedisStreamEntries Redis::xrange_entries(const char *key, const char *start,
+                                         const char *end, unsigned int count)
+{
+  return RedisStreamEntries(_xrange_("XRANGE", key, start, end, count), false);
+}
+
+int Redis::xrange_entries(const char *key, const char *start, const char *end,
+                          unsigned int count, RedisStreamEntryCallback callback)
+{
+  StreamEntrySink sink(this, callback, *reader, RangeEntryDepth);
+  return sink.finish(_xrange_("XRANGE", key, start, end, count));
+}
+
+std::shared_ptr<RedisObject> Redis::_xread_(unsigned int count, unsigned int block,
+                                            const char *key, const char *id)
 {
   ArgList argList = std::vector<String>();
 
@@ -479,7 +1082,13 @@ std::vector<String> Redis::xread(unsigned int count, unsigned int block,
   argList.push_back(key);
   argList.push_back(id);
 
-  auto rv = RedisCommand("XREAD", argList).issue(conn);
+  return RedisCommand::issue(*reader, "XREAD", argList);
+}
+
+std::vector<String> Redis::xread(unsigned int count, unsigned int block,
+                                 const char *key, const char *id)
+{
+  auto rv = _xread_(count, block, key, id);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -496,9 +1105,22 @@ std::vector<String> Redis::xread(unsigned int count, unsigned int block,
   }
 }
 
-std::vector<String> Redis::xreadgroup(const char *group, const char *consumer,
-                                      unsigned int count, unsigned int block_ms, bool noack, const char *key,
-                                      const char *id)
+RedisStreamEntries Redis::xread_entries(unsigned int count, unsigned int block,
+                                        const char *key, const char *id)
+{
+  return RedisStreamEntries(_xread_(count, block, key, id), true);
+}
+
+int Redis::xread_entries(unsigned int count, unsigned int block, const char *key,
+                         const char *id, RedisStreamEntryCallback callback)
+{
+  StreamEntrySink sink(this, callback, *reader, ReadEntryDepth(resp3));
+  return sink.finish(_xread_(count, block, key, id));
+}
+
+std::shared_ptr<RedisObject> Redis::_xreadgroup_(const char *group, const char *consumer,
+                                                 unsigned int count, unsigned int block_ms, bool noack,
+                                                 const char *key, const char *id)
 {
   ArgList argList = ArgList{"GROUP", group, consumer};
 
@@ -527,7 +1149,14 @@ std::vector<String> Redis::xreadgroup(const char *group, const char *consumer,
 
   argList.push_back(id);
 
-  auto rv = RedisCommand("XREADGROUP", argList).issue(conn);
+  return RedisCommand::issue(*reader, "XREADGROUP", argList);
+}
+
+std::vector<String> Redis::xreadgroup(const char *group, const char *consumer,
+                                      unsigned int count, unsigned int block_ms, bool noack, const char *key,
+                                      const char *id)
+{
+  auto rv = _xreadgroup_(group, consumer, count, block_ms, noack, key, id);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -544,18 +1173,25 @@ std::vector<String> Redis::xreadgroup(const char *group, const char *consumer,
   }
 }
 
-std::vector<String> Redis::xrevrange(const char *key, const char *end,
-                                     const char *start, unsigned int count)
+RedisStreamEntries Redis::xreadgroup_entries(const char *group, const char *consumer,
+                                             unsigned int count, unsigned int block_ms, bool noack,
+                                             const char *key, const char *id)
 {
-  ArgList argList = ArgList{key, end, start};
+  return RedisStreamEntries(_xreadgroup_(group, consumer, count, block_ms, noack, key, id), true);
+}
 
-  if (count > 0)
-  {
-    argList.push_back("COUNT");
-    argList.push_back(String(count));
-  }
+int Redis::xreadgroup_entries(const char *group, const char *consumer, unsigned int count,
+                              unsigned int block_ms, bool noack, const char *key, const char *id,
+                              RedisStreamEntryCallback callback)
+{
+  StreamEntrySink sink(this, callback, *reader, ReadEntryDepth(resp3));
+  return sink.finish(_xreadgroup_(group, consumer, count, block_ms, noack, key, id));
+}
 
-  auto rv = RedisCommand("XREVRANGE", argList).issue(conn);
+std::vector<String> Redis::xrevrange(const char *key, const char *end,
+                                     const char *start, unsigned int count)
+{
+  auto rv = _xrange_("XREVRANGE", key, end, start, count);
 
   if (rv->type() == RedisObject::Type::InternalError)
   {
@@ -572,6 +1208,19 @@ std::vector<String> Redis::xrevrange(const char *key, const char *end,
   }
 }
 
+RedisStreamEntries Redis::xrevrange_entries(const char *key, const char *end,
+                                            const char *start, unsigned int count)
+{
+  return RedisStreamEntries(_xrange_("XREVRANGE", key, end, start, count), false);
+}
+
+int Redis::xrevrange_entries(const char *key, const char *end, const char *start,
+                             unsigned int count, RedisStreamEntryCallback callback)
+{
+  StreamEntrySink sink(this, callback, *reader, RangeEntryDepth);
+  return sink.finish(_xrange_("XREVRANGE", key, end, start, count));
+}
+
 int Redis::xtrim(const char *key, const char *strategy, XtrimCompareType compare,
                  const int threshold, const int count)
 {
@@ -580,17 +1229,17 @@ int Redis::xtrim(const char *key, const char *strategy, XtrimCompareType compare
     if (count > 0)
     {
       TRCMD(int, "XTRIM", key, strategy, String(char(compare)),
-            String(threshold), "LIMIT", String(count));
+            threshold, "LIMIT", count);
     }
     else
     {
-      TRCMD(int, "XTRIM", key, strategy, String(threshold));
+      TRCMD(int, "XTRIM", key, strategy, threshold);
     }
   }
   else
   {
     TRCMD(int, "XTRIM", key, strategy, String(char(compare)),
-          String(threshold));
+          threshold);
   }
 }
 
@@ -609,110 +1258,680 @@ int Redis::rpush(const char *key, const char *value, bool exclusive)
   TRCMD(int, (exclusive ? "RPUSHX" : "RPUSH"), key, value);
 }
 
-bool Redis::_subscribe(SubscribeSpec spec)
+// A score as returned: a bulk string under RESP2, a double under RESP3; NAN if neither
+static double scoreOf(std::shared_ptr<RedisObject> score)
+{
+  return RedisCommand::convert_typed<double>(score);
+}
+
+// The members of a reply to ZRANGE, ZPOPMIN and the like, each with its score unless `withScores` is false.
+// RESP2 alternates members and scores; RESP3 nests each member with its score.
+static std::vector<RedisScoredMember> scoredMembers(std::shared_ptr<RedisObject> rv, bool withScores)
+{
+  std::vector<RedisScoredMember> members;
+  if (rv->type() != RedisObject::Type::Array)
+  {
+    return members;
+  }
+
+  auto elements = (RedisArray *)rv.get();
+  auto nested = elements->size() && elements->at(0)->type() == RedisObject::Type::Array;
+  size_t step = withScores && !nested ? 2 : 1;
+  members.reserve(elements->size() / step);
+  for (size_t i = 0; i + step <= elements->size(); i += step)
+  {
+    if (nested)
+    {
+      auto pair = (RedisArray *)elements->at(i).get();
+      members.push_back({(String)*pair->at(0), scoreOf(pair->at(1))});
+    }
+    else
+    {
+      members.push_back({(String)*elements->at(i), withScores ? scoreOf(elements->at(i + 1)) : 0});
+    }
+  }
+  return members;
+}
+
+// The arguments of ZRANGE (with `dst` null) or ZRANGESTORE
+static ArgList rangeArgs(const char *dst, const char *src, const char *start, const char *stop,
+                         RedisZRangeBy by, bool rev, int offset, int count)
+{
+  ArgList argList;
+  argList.reserve(10);
+  if (dst)
+  {
+    argList.push_back(dst);
+  }
+  argList.push_back(src);
+  argList.push_back(start);
+  argList.push_back(stop);
+
+  if (by != RedisZRangeByRank)
+  {
+    argList.push_back(by == RedisZRangeByScore ? "BYSCORE" : "BYLEX");
+    if (offset > 0 || count >= 0)
+    {
+      argList.push_back("LIMIT");
+      argList.push_back(String(offset));
+      argList.push_back(String(count));
+    }
+  }
+
+  if (rev)
+  {
+    argList.push_back("REV");
+  }
+
+  // scores may not be asked for along with a range by lex
+  if (!dst && by != RedisZRangeByLex)
+  {
+    argList.push_back("WITHSCORES");
+  }
+  return argList;
+}
+
+int Redis::zadd(const char *key, const std::vector<RedisScoredMember> &members, const char *condition)
+{
+  ArgList argList;
+  argList.reserve(members.size() * 2 + 2);
+  argList.push_back(key);
+  if (condition)
+  {
+    argList.push_back(condition);
+  }
+
+  for (auto &member : members)
+  {
+    argList.push_back(doubleArg(member.score));
+    argList.push_back(member.member);
+  }
+  return RedisCommand::convert_typed<int>(RedisCommand::issue(*reader, "ZADD", argList));
+}
+
+double Redis::zincrby(const char *key, double increment, const char *member)
+{
+  return scoreOf(RedisCommand::issue(*reader, {"ZINCRBY", key, doubleArg(increment), member}));
+}
+
+int Redis::zcard(const char *key)
+{
+  TRCMD(int, "ZCARD", key);
+}
+
+std::vector<RedisScoredMember> Redis::zrange(const char *key, const char *start, const char *stop,
+                                             RedisZRangeBy by, bool rev, int offset, int count)
+{
+  auto rv = RedisCommand::issue(*reader, "ZRANGE", rangeArgs(nullptr, key, start, stop, by, rev, offset, count));
+  return scoredMembers(rv, by != RedisZRangeByLex);
+}
+
+int Redis::zrangestore(const char *dst, const char *src, const char *start, const char *stop,
+                       RedisZRangeBy by, bool rev, int offset, int count)
+{
+  auto rv = RedisCommand::issue(*reader, "ZRANGESTORE", rangeArgs(dst, src, start, stop, by, rev, offset, count));
+  return RedisCommand::convert_typed<int>(rv);
+}
+
+int Redis::zremrangebyscore(const char *key, const char *min, const char *max)
+{
+  TRCMD(int, "ZREMRANGEBYSCORE", key, min, max);
+}
+
+std::vector<RedisScoredMember> Redis::zpopmin(const char *key, unsigned int count)
+{
+  return scoredMembers(RedisCommand::issue(*reader, {"ZPOPMIN", key, count}), true);
+}
+
+bool Redis::bzpopmin(const std::vector<String> &keys, double timeout, RedisScoredMember &popped, String *from)
+{
+  ArgList argList(keys);
+  argList.push_back(doubleArg(timeout));
+
+  // [key, member, score], or a null once `timeout` has elapsed
+  auto rv = RedisCommand::issue(*reader, "BZPOPMIN", argList);
+  if (rv->type() != RedisObject::Type::Array || ((RedisArray *)rv.get())->size() != 3)
+  {
+    return false;
+  }
+
+  auto elements = (RedisArray *)rv.get();
+  if (from)
+  {
+    *from = (String)*elements->at(0);
+  }
+  popped.member = (String)*elements->at(1);
+  popped.score = scoreOf(elements->at(2));
+  return true;
+}
+
+// `true` if `obj` is the bulk string `str`
+static bool bulkEquals(const std::shared_ptr<RedisObject> &obj, const char *str)
+{
+  if (!obj || obj->type() != RedisObject::Type::BulkString)
+  {
+    return false;
+  }
+
+  auto bulk = (RedisBulkString *)obj.get();
+  auto len = strlen(str);
+  return bulk->length() == len && !memcmp(bulk->bytes(), str, len);
+}
+
+// `true` if `reply` confirms a (un)subscription, rather than being a message
+static bool isSubscriptionReply(RedisArray *reply)
 {
+  static const char *kinds[] = {"subscribe", "psubscribe", "ssubscribe", "unsubscribe", "punsubscribe", "sunsubscribe"};
+  for (auto kind : kinds)
+  {
+    if (bulkEquals(reply->at(0), kind))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The keys `msg` invalidates if it is one of CLIENT TRACKING's invalidations: pushed as ["invalidate", keys]
+// under RESP3, or redirected to another connection as ["message", "__redis__:invalidate", keys]
+static std::shared_ptr<RedisObject> invalidatedKeys(RedisArray *msg)
+{
+  if (msg->size() == 2 && bulkEquals(msg->at(0), "invalidate"))
+  {
+    return msg->at(1);
+  }
+
+  if (msg->size() == 3 && bulkEquals(msg->at(0), "message") && bulkEquals(msg->at(1), "__redis__:invalidate"))
+  {
+    return msg->at(2);
+  }
+  return nullptr;
+}
+
+static const char *subscribeCommand(int kind, bool unsubscribe)
+{
+  static const char *commands[][2] = {
+      {"SUBSCRIBE", "UNSUBSCRIBE"},
+      {"PSUBSCRIBE", "PUNSUBSCRIBE"},
+      {"SSUBSCRIBE", "SUNSUBSCRIBE"},
+  };
+  return commands[kind][unsubscribe ? 1 : 0];
+}
+
+// Encodes `command` for `specs`: a single command for them all, or if `perSpec`, one apiece
+// (as shard channels need, since each may belong to a different cluster slot)
+static void encodeSubscribe(RedisEncoder &encoder, const char *command, const ArgList &specs, bool perSpec)
+{
+  if (!perSpec)
+  {
+    encoder.command(command, specs);
+    return;
+  }
+
+  for (const auto &spec : specs)
+  {
+    encoder.command({command, spec});
+  }
+}
+
+bool Redis::_subscribe(SubscribeKind kind, const std::vector<String> &specs)
+{
+  if (!specs.size())
+  {
+    return false;
+  }
+
+  for (const auto &spec : specs)
+  {
+    bool known = false;
+    for (const auto &existing : subSpec)
+    {
+      known = known || (existing.kind == kind && existing.spec == spec);
+    }
+
+    if (!known)
+    {
+      subSpec.push_back(SubscribeSpec{kind, spec});
+    }
+  }
+
   if (!subscriberMode)
   {
-    subSpec.push_back(spec);
     return true;
   }
 
-  const char *cmdName = spec.pattern ? "PSUBSCRIBE" : "SUBSCRIBE";
-  auto rv = RedisCommand(cmdName, ArgList{spec.spec}).issue(conn);
-  return rv->type() == RedisObject::Type::Array;
+  // the confirmations are consumed by _dispatchMessage() along with any messages
+  RedisEncoder encoder(conn);
+  encodeSubscribe(encoder, subscribeCommand(kind, false), specs, kind == SubscribeShard);
+  encoder.flush();
+  return !encoder.overflowed();
 }
 
-bool Redis::unsubscribe(const char *channelOrPattern)
+bool Redis::unsubscribe(const std::vector<String> &channelsOrPatterns)
 {
-  auto rv = RedisCommand("UNSUBSCRIBE", ArgList{channelOrPattern}).issue(conn);
+  if (!channelsOrPatterns.size())
+  {
+    return false;
+  }
 
-  if (rv->type() == RedisObject::Type::Array)
+  // anything not known to be a pattern or shard channel is unsubscribed from as a channel
+  ArgList byKind[3];
+  bool allKnown = true;
+  for (const auto &name : channelsOrPatterns)
   {
-    auto vec = (std::vector<String>)*((RedisArray *)rv.get());
-    return vec.size() == 3 && vec[1] == String(channelOrPattern);
+    auto kind = SubscribeChannel;
+    bool known = false;
+    for (auto it = subSpec.begin(); it != subSpec.end();)
+    {
+      if (it->spec == name)
+      {
+        kind = it->kind;
+        known = true;
+        it = subSpec.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    allKnown = allKnown && known;
+    byKind[kind].push_back(name);
   }
 
-  return false;
+  if (!subscriberMode)
+  {
+    return allKnown;
+  }
+
+  RedisEncoder encoder(conn);
+  for (int kind = SubscribeChannel; kind <= SubscribeShard; kind++)
+  {
+    if (byKind[kind].size())
+    {
+      encodeSubscribe(encoder, subscribeCommand(kind, true), byKind[kind], kind == SubscribeShard);
+    }
+  }
+  encoder.flush();
+  return !encoder.overflowed();
 }
 
-RedisSubscribeResult Redis::startSubscribingNonBlocking(RedisMsgCallback messageCallback, LoopCallback loopCallback, RedisMsgErrorCallback errCallback)
+RedisSubscribeResult Redis::beginSubscribing(RedisMsgCallback messageCallback, RedisMsgErrorCallback errCallback)
+{
+  if (!messageCallback)
+  {
+    return RedisSubscribeBadCallback;
+  }
+
+  subMsgCallback = messageCallback;
+  subMsgViewCallback = nullptr;
+  return _beginSubscribing(errCallback);
+}
+
+RedisSubscribeResult Redis::beginSubscribing(RedisMsgViewCallback messageCallback, RedisMsgErrorCallback errCallback)
 {
   if (!messageCallback)
   {
     return RedisSubscribeBadCallback;
   }
 
-  bool success = true;
+  subMsgCallback = nullptr;
+  subMsgViewCallback = messageCallback;
+  return _beginSubscribing(errCallback);
+}
+
+RedisSubscribeResult Redis::_beginSubscribing(RedisMsgErrorCallback errCallback)
+{
+  wait();
   subscriberMode = true;
-  if (subSpec.size())
+  subErrCallback = errCallback;
+  subLoopRun = true;
+
+  if (!subSpec.size())
   {
-    for (auto spec : subSpec)
+    return RedisSubscribeSuccess;
+  }
+
+  // the replies due to each command written: a confirmation per subscription, or else a single error refusing it
+  std::deque<size_t> awaited;
+
+  // every subscription is written (or unsubscribed from) at once, with as few commands as possible,
+  // costing a single round trip
+  auto encodeAll = [&](bool unsubscribe)
+  {
+    RedisEncoder encoder(conn);
+    for (int kind = SubscribeChannel; kind <= SubscribeShard; kind++)
     {
-      success = _subscribe(spec) && success;
+      ArgList specs;
+      for (const auto &spec : subSpec)
+      {
+        if (spec.kind == kind)
+        {
+          specs.push_back(spec.spec);
+        }
+      }
+
+      if (specs.size())
+      {
+        encodeSubscribe(encoder, subscribeCommand(kind, unsubscribe), specs, kind == SubscribeShard);
+        if (kind == SubscribeShard)
+        {
+          awaited.insert(awaited.end(), specs.size(), 1);
+        }
+        else
+        {
+          awaited.push_back(specs.size());
+        }
+      }
     }
+  };
+
+  // messages on the subscriptions already confirmed may arrive in between the replies: they are dispatched
+  // if `dispatch`, and otherwise dropped. (Under RESP3 both are push frames, so are read here as replies rather
+  // than routed by _routePush().)
+  // @return Whether the commands were all answered, any refused, rather than the connection failing first
+  bool refused = false;
+  auto awaitAll = [&](bool dispatch) -> bool
+  {
+    while (awaited.size())
+    {
+      auto reply = RedisObject::parseType(*reader);
+      auto type = reply->type();
+      if (type == RedisObject::Type::Array && isSubscriptionReply((RedisArray *)reply.get()))
+      {
+        if (!--awaited.front())
+        {
+          awaited.pop_front();
+        }
+      }
+      else if (type == RedisObject::Type::Array && dispatch)
+      {
+        _dispatchMessage(reply);
+      }
+      else if (type == RedisObject::Type::Array)
+      {
+        // invalidations are still for the cache
+        auto invalidated = invalidatedCache ? invalidatedKeys((RedisArray *)reply.get()) : nullptr;
+        if (invalidated)
+        {
+          _invalidate(invalidated);
+        }
+      }
+      else if (type == RedisObject::Type::InternalError)
+      {
+        return false;
+      }
+      else
+      {
+        refused = true;
+        awaited.pop_front();
+      }
+    }
+    return true;
+  };
+
+  encodeAll(false);
+  reader->setPushHandler(nullptr, nullptr);
+  auto answered = awaitAll(true);
+
+  if (answered && !refused)
+  {
+    reader->setPushHandler(_routePush, this);
+    return RedisSubscribeSuccess;
   }
 
-  if (!success)
+  // leave subscriber mode, so that the connection can be used for commands again: unsubscribing by name from
+  // everything asked for, whether or not it was confirmed, is answered by a known number of replies (unlike
+  // UNSUBSCRIBE alone), so none is left unread to be taken for the reply to a later command
+  if (answered)
   {
-    return RedisSubscribeSetupFailure;
+    encodeAll(true);
+    awaitAll(false);
   }
 
+  reader->setPushHandler(_routePush, this);
+  subscriberMode = false;
+  subLoopRun = false;
+  subMsgCallback = nullptr;
+  subMsgViewCallback = nullptr;
+  return RedisSubscribeSetupFailure;
+}
+
+RedisSubscribeResult Redis::_dispatchMessage(std::shared_ptr<RedisObject> msg)
+{
   auto emitErr = [=](RedisMessageError errCode) -> void
   {
-    if (errCallback)
+    if (subErrCallback)
     {
-      errCallback(this, errCode);
+      subErrCallback(this, errCode);
     }
   };
 
-  subLoopRun = true;
-  while (subLoopRun)
+  if (msg->type() == RedisObject::Type::InternalError)
   {
-    loopCallback();
-    auto msg = RedisObject::parseTypeNonBlocking(conn);
-    if (msg == nullptr)
+    auto errPtr = (RedisInternalError *)msg.get();
+
+    if (errPtr->code() == RedisInternalError::Disconnected)
     {
-      continue;
+      return RedisSubscribeServerDisconnected;
     }
 
-    if (msg->type() == RedisObject::Type::InternalError)
+    return RedisSubscribeOtherError;
+  }
+
+  if (msg->type() != RedisObject::Type::Array)
+  {
+    emitErr(RedisMessageBadResponseType);
+    return RedisSubscribeSuccess;
+  }
+
+  auto msgArr = (RedisArray *)msg.get();
+
+  // invalidations are for the cache alone
+  auto invalidated = invalidatedCache ? invalidatedKeys(msgArr) : nullptr;
+  if (invalidated)
+  {
+    _invalidate(invalidated);
+    return RedisSubscribeSuccess;
+  }
+
+  if (msgArr->size() < 3)
+  {
+    emitErr(RedisMessageTruncatedResponse);
+    return RedisSubscribeSuccess;
+  }
+
+  if (isSubscriptionReply(msgArr))
+  {
+    return RedisSubscribeSuccess;
+  }
+
+  // pmessage payloads have an extra paramter at index 1 that specifies the matched pattern;
+  // smessage payloads (from a shard channel) are otherwise the same as message payloads
+  auto isPMessage = bulkEquals(msgArr->at(0), "pmessage");
+  if (!isPMessage && !bulkEquals(msgArr->at(0), "message") && !bulkEquals(msgArr->at(0), "smessage"))
+  {
+    emitErr(RedisMessageUnknownType);
+    return RedisSubscribeSuccess;
+  }
+
+  size_t partCount = isPMessage ? 3 : 2;
+  if (msgArr->size() < 1 + partCount)
+  {
+    emitErr(RedisMessageTruncatedResponse);
+    return RedisSubscribeSuccess;
+  }
+
+  RedisBulkString *parts[3] = {nullptr, nullptr, nullptr};
+  for (size_t i = 1; i <= partCount; i++)
+  {
+    auto part = msgArr->at(i);
+    if (part->type() != RedisObject::Type::BulkString)
     {
-      auto errPtr = (RedisInternalError *)msg.get();
+      emitErr(RedisMessageBadResponseType);
+      return RedisSubscribeSuccess;
+    }
+    parts[i - 1] = (RedisBulkString *)part.get();
+  }
 
-      if (errPtr->code() == RedisInternalError::Disconnected)
-      {
-        return RedisSubscribeServerDisconnected;
-      }
+  auto pattern = isPMessage ? parts[0] : nullptr;
+  auto channel = parts[isPMessage ? 1 : 0];
+  auto message = parts[isPMessage ? 2 : 1];
+
+  if (subMsgViewCallback)
+  {
+    RedisMessage view = {
+        (const char *)channel->bytes(), channel->length(),
+        message->bytes(), message->length(),
+        pattern ? (const char *)pattern->bytes() : nullptr, pattern ? pattern->length() : 0};
+    subMsgViewCallback(this, view);
+  }
+  else
+  {
+    subMsgCallback(this, (String)*channel, (String)*message);
+  }
+  return RedisSubscribeSuccess;
+}
+
+void Redis::_routePush(std::shared_ptr<RedisObject> push, void *context)
+{
+  auto redis = (Redis *)context;
+  auto pushArr = (RedisArray *)push.get();
+
+  // (un)subscribing never waits on its confirmation
+  if (isSubscriptionReply(pushArr))
+  {
+    return;
+  }
+
+  auto invalidated = redis->invalidatedCache ? invalidatedKeys(pushArr) : nullptr;
+  if (invalidated)
+  {
+    redis->_invalidate(invalidated);
+    return;
+  }
+
+  auto isMessage = bulkEquals(pushArr->at(0), "message") || bulkEquals(pushArr->at(0), "pmessage") ||
+                   bulkEquals(pushArr->at(0), "smessage");
+  if (isMessage && redis->subLoopRun && (redis->subMsgCallback || redis->subMsgViewCallback))
+  {
+    redis->_dispatchMessage(push);
+  }
+  else if (redis->pushCallback)
+  {
+    redis->pushCallback(redis, push);
+  }
+}
+
+void Redis::_invalidate(std::shared_ptr<RedisObject> keys)
+{
+  // null rather than keys when the server flushed its tracking table (e.g. on FLUSHALL): nothing cached is known good
+  if (keys->type() != RedisObject::Type::Array || !((RedisArray *)keys.get())->size())
+  {
+    invalidatedCache->clear();
+    return;
+  }
 
-      return RedisSubscribeOtherError;
+  auto keyArr = (RedisArray *)keys.get();
+  for (size_t i = 0; i < keyArr->size(); i++)
+  {
+    auto key = keyArr->at(i);
+    if (key->type() == RedisObject::Type::BulkString)
+    {
+      auto bulk = (RedisBulkString *)key.get();
+      invalidatedCache->invalidate((const char *)bulk->bytes(), bulk->length());
     }
+  }
+}
+
+RedisSubscribeResult Redis::pollSubscriptions()
+{
+  if (!subMsgCallback && !subMsgViewCallback)
+  {
+    return RedisSubscribeBadCallback;
+  }
 
-    if (msg->type() != RedisObject::Type::Array)
+  // only parse once bytes have arrived, so an idle poll costs no more than a call to available()
+  while (subLoopRun && (reader->available() > 0 || reader->parser().inProgress()))
+  {
+    auto msg = RedisObject::parseTypeNonBlocking(*reader);
+    if (msg == nullptr)
     {
-      emitErr(RedisMessageBadResponseType);
-      continue;
+      // the rest of this message is yet to arrive
+      break;
     }
 
-    auto msgVec = (std::vector<String>)*((RedisArray *)msg.get());
+    auto result = _dispatchMessage(msg);
+    if (result == RedisSubscribeServerDisconnected)
+    {
+      break;
+    }
+    else if (result != RedisSubscribeSuccess)
+    {
+      return result;
+    }
+  }
 
-    if (msgVec.size() < 3)
+  if (subLoopRun && !reader->connected())
+  {
+    reader->parser().reset();
+    // a managed connection is restored, subscriptions and all, once its backoff allows; there is nothing to read till then
+    if (reader->disconnectHandler())
     {
-      emitErr(RedisMessageTruncatedResponse);
-      continue;
+      reader->reconnect(nullptr, 0);
+      return subLoopRun ? RedisSubscribeSuccess : RedisSubscribeServerDisconnected;
     }
+    return RedisSubscribeServerDisconnected;
+  }
+
+  return RedisSubscribeSuccess;
+}
+
+RedisSubscribeResult Redis::_subscriberLoop(LoopCallback loopCallback)
+{
+  unsigned long idleDelay = 0;
+  auto result = RedisSubscribeSuccess;
 
-    if (msgVec[0] != "message" && msgVec[0] != "pmessage")
+  while (result == RedisSubscribeSuccess && subLoopRun)
+  {
+    loopCallback();
+
+    auto consumedBefore = reader->consumed();
+    result = pollSubscriptions();
+    if (reader->consumed() != consumedBefore)
     {
-      emitErr(RedisMessageUnknownType);
+      idleDelay = 0;
       continue;
     }
 
-    // pmessage payloads have an extra paramter at index 1 that specifies the matched pattern; we ignore it here
-    auto pMsgAdd = msgVec[0] == "pmessage" ? 1 : 0;
-    messageCallback(this, msgVec[1 + pMsgAdd], msgVec[2 + pMsgAdd]);
+    switch (subIdle)
+    {
+    case RedisIdleSpin:
+      break;
+    case RedisIdleYield:
+      yield();
+      break;
+    case RedisIdleBackoff:
+      idleDelay = idleDelay ? idleDelay * 2 : 1;
+      idleDelay = idleDelay < subIdleMaxDelay ? idleDelay : subIdleMaxDelay;
+      delay(idleDelay);
+      break;
+    }
   }
 
-  return RedisSubscribeSuccess;
+  return result;
+}
+
+RedisSubscribeResult Redis::startSubscribingNonBlocking(RedisMsgCallback messageCallback, LoopCallback loopCallback, RedisMsgErrorCallback errCallback)
+{
+  auto result = beginSubscribing(messageCallback, errCallback);
+  return result == RedisSubscribeSuccess ? _subscriberLoop(loopCallback) : result;
+}
+
+RedisSubscribeResult Redis::startSubscribingNonBlocking(RedisMsgViewCallback messageCallback, LoopCallback loopCallback, RedisMsgErrorCallback errCallback)
+{
+  auto result = beginSubscribing(messageCallback, errCallback);
+  return result == RedisSubscribeSuccess ? _subscriberLoop(loopCallback) : result;
 }
 
 RedisSubscribeResult Redis::startSubscribing(RedisMsgCallback messageCallback, RedisMsgErrorCallback errCallback)
@@ -721,6 +1940,12 @@ RedisSubscribeResult Redis::startSubscribing(RedisMsgCallback messageCallback, R
       messageCallback, [] {}, errCallback);
 }
 
+RedisSubscribeResult Redis::startSubscribing(RedisMsgViewCallback messageCallback, RedisMsgErrorCallback errCallback)
+{
+  return startSubscribingNonBlocking(
+      messageCallback, [] {}, errCallback);
+}
+
 bool Redis::isErrorReturn(std::vector<String> &returnVec)
 {
   return ((returnVec[0].c_str())[0] == '-');
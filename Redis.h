@@ -31,12 +31,24 @@
 #include "Client.h"
 
 #include <vector>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+
+#include "RedisResult.h"
+
+class RedisReader;
+class RedisObject;
+class RedisArg;
+class RedisVisitor;
+class RedisClientCache;
 
 /** The return value from from `Redis::authenticate()` */
 typedef enum
 {
   RedisSuccess = 0,
-  /// Authenticate attempted before the connection has been established.
+  /// Authenticate attempted before the connection has been established, or it was lost before the reply.
   RedisNotConnectedFailure = 1,
   /// The authentication credentials used are not valid.
   RedisAuthFailure = 2,
@@ -56,6 +68,18 @@ typedef enum
   RedisSubscribeSuccess = 0
 } RedisSubscribeResult;
 
+/** How `Redis::startSubscribingNonBlocking()` waits while no message is arriving. See `Redis::setSubscriberIdle()`. */
+typedef enum
+{
+  /// Poll again immediately: the lowest latency, at the cost of a fully busy CPU.
+  RedisIdleSpin,
+  /// Call `yield()` between polls, letting the platform's background tasks run.
+  RedisIdleYield,
+  /// `delay()` between polls, doubling from 1ms up to a maximum while the connection stays idle,
+  /// so that the CPU can sleep (e.g. ESP32 light sleep) between messages.
+  RedisIdleBackoff,
+} RedisIdleStrategy;
+
 /** A value of this type will be passed as the second argument ot `Redis::RedisMsgErrorCallback`, if called */
 typedef enum
 {
@@ -76,6 +100,95 @@ typedef enum
   XtrimCompareAtLeast = '~'
 } XtrimCompareType;
 
+/** How `Redis::zrange()` and `Redis::zrangestore()` interpret their `start` and `stop` */
+typedef enum
+{
+  /// As ranks: zero-based indexes, negative ones counting from the end (e.g. "0" and "-1" for the whole set).
+  RedisZRangeByRank = 0,
+  /// As scores, inclusive unless prefixed with "(" (e.g. "(1700000000"); "-inf" and "+inf" are unbounded.
+  RedisZRangeByScore,
+  /// As members, for a set whose members all share one score: "[a" inclusive, "(a" exclusive, "-" and "+" unbounded.
+  RedisZRangeByLex,
+} RedisZRangeBy;
+
+/** A member of a sorted set, and its score */
+struct RedisScoredMember
+{
+  String member;
+  double score;
+};
+
+/** One stream entry, as returned by XRANGE, XREAD and the like: an ID and its field/value pairs.
+ *  A view into the parsed reply, which it keeps alive: nothing is copied until a field or value is read.
+ */
+class RedisStreamEntry
+{
+public:
+  RedisStreamEntry() {}
+  RedisStreamEntry(std::shared_ptr<RedisObject> entry) : entry(entry) {}
+
+  /** The entry's ID, e.g. "1526985054069-0" */
+  String id() const;
+
+  /** The number of field/value pairs; 0 for an entry since deleted from the stream (as XREADGROUP may report) */
+  size_t size() const;
+
+  /** The name of the `index`th field */
+  String field(size_t index) const;
+
+  /** The value of the `index`th field */
+  String value(size_t index) const;
+
+  /** The value of `field`, or "(nil)" if the entry has no such field */
+  String value(const String &field) const;
+
+private:
+  std::shared_ptr<RedisObject> entry;
+};
+
+/** The stream entries of an XRANGE, XREVRANGE, XREAD or XREADGROUP reply, in the order returned */
+class RedisStreamEntries
+{
+public:
+  RedisStreamEntries() {}
+
+  /**
+   * @param reply The reply to XRANGE or XREVRANGE, or to XREAD or XREADGROUP (for a single stream)
+   * @param perStream `true` for XREAD and XREADGROUP, which nest entries within one element per stream
+   */
+  RedisStreamEntries(std::shared_ptr<RedisObject> reply, bool perStream);
+
+  /** The number of entries */
+  size_t size() const;
+
+  RedisStreamEntry operator[](size_t index) const;
+
+  /** `true` if the command failed, in which case there are no entries */
+  bool isError() const;
+
+  /** The error returned, if `isError()` */
+  String error() const;
+
+private:
+  std::shared_ptr<RedisObject> reply;
+  std::shared_ptr<RedisObject> entries;
+};
+
+/** A pub/sub message, as passed to `Redis::RedisMsgViewCallback`: views of the bytes as received, copied no further.
+ *  Valid only for the duration of the callback, so copy out anything needed for longer.
+ *  Each is NUL-terminated, so may be used as a C string unless it may itself contain a NUL.
+ */
+struct RedisMessage
+{
+  const char *channel;
+  size_t channelLength;
+  const uint8_t *message;
+  size_t messageLength;
+  /// The pattern that `channel` matched, for a message received by way of `psubscribe()`; otherwise `nullptr`
+  const char *pattern;
+  size_t patternLength;
+};
+
 /** Redis-for-Arduino client interface.
  *
  *  The sole constructor takes a reference to any instance
@@ -89,23 +202,40 @@ class Redis
 public:
   /** Called upon successful receipt of a pub/sub `message` on subscribed `channel` */
   typedef void (*RedisMsgCallback)(Redis *, String channel, String message);
+  /** As `RedisMsgCallback`, but without copying the message, and with the matched pattern (if any); see `RedisMessage`.
+   *  With `setReplyArena(true)` as well, each message costs only a few heap allocations in all. */
+  typedef void (*RedisMsgViewCallback)(Redis *, const RedisMessage &message);
   typedef void (*LoopCallback)();
   /** Called upon an error in the receipt of a pub/sub message */
   typedef void (*RedisMsgErrorCallback)(Redis *, RedisMessageError);
+  /** Called with each RESP3 push frame not otherwise handled; see `setPushHandler()` */
+  typedef void (*RedisPushCallback)(Redis *, std::shared_ptr<RedisObject> push);
+  /** Called with the reply to a command issued by `issueAsync()` (or the other `...Async()` methods), and the context given */
+  typedef void (*RedisReplyCallback)(Redis *, std::shared_ptr<RedisObject> reply, void *context);
+  /** Called with each stream entry as it is read */
+  typedef void (*RedisStreamEntryCallback)(Redis *, const RedisStreamEntry &entry);
 
   /**
    * Create a Redis connection using Client reference `client`.
    * @param client A Client instance representing the connection to a Redis server.
    * @returns An initialized Redis client using `client` to communicate with the server.
    */
-  Redis(Client &client) : conn(client) {}
+  Redis(Client &client);
 
-  ~Redis() {}
+  ~Redis();
   Redis(const Redis &) = delete;
   Redis &operator=(const Redis &) = delete;
   Redis(const Redis &&) = delete;
   Redis &operator=(const Redis &&) = delete;
 
+  /**
+   * Parse each array reply (e.g. from XRANGE or XREADGROUP) into a single arena, so that it
+   * costs a few heap allocations rather than several per element, and is freed all at once.
+   * Holding on to any element of such a reply holds the memory of the whole reply.
+   * @param enabled Whether to use an arena. Defaults to `REDIS_USE_ARENA`, itself off by default.
+   */
+  void setReplyArena(bool enabled);
+
   /**
    * Authenticate with the given password.
    * @param password The password with which to authenticate.
@@ -113,6 +243,89 @@ public:
    */
   RedisReturnValue authenticate(const char *password);
 
+  /**
+   * Switch the connection's protocol with HELLO: to RESP3 (Redis 6 and later) by default.
+   * Under RESP3 replies carry richer types (see `RedisObject::wireType()`: e.g. HGETALL returns a Map, readable
+   * with `RedisArray::lookup()`), and pub/sub messages arrive as push frames. Subscriptions then share the
+   * command connection: messages arriving while a command awaits its reply are handled then and there, and
+   * commands may be issued while subscribed (though not from within message callbacks).
+   * @param protocolVersion 3 for RESP3, or 2 to switch back.
+   * @return `true` if the server switched protocol.
+   */
+  bool hello(int protocolVersion = 3);
+
+  /**
+   * Handle each RESP3 push frame that is not a pub/sub message (or (un)subscription confirmation) for the
+   * subscription callbacks, e.g. the invalidations of CLIENT TRACKING. Push frames arrive in between replies,
+   * so `handler` may be called during any command; it must not issue commands itself.
+   * @param handler Called with the push frame: a RedisArray whose first element names its kind. `nullptr` to ignore them.
+   */
+  void setPushHandler(RedisPushCallback handler) { pushCallback = handler; }
+
+  /**
+   * Serve `get()` and `hget()` from `cache` where possible, keeping it coherent with the server through
+   * CLIENT TRACKING: the server tracks the keys read by this connection, and sends an invalidation (as a RESP3
+   * push frame) for each once it changes, dropping it from the cache. Invalidations are applied as they are read,
+   * i.e. during the next command, so a value changed by another client may be read from the cache until then.
+   * Requires RESP3: call `hello()` first, or use the overload below.
+   * @param cache The cache to use; it must outlive its use by this connection.
+   * @return `true` if the server enabled tracking.
+   */
+  bool enableClientCache(RedisClientCache &cache);
+
+  /**
+   * As above, but under RESP2: the server redirects its invalidations to the `__redis__:invalidate` channel
+   * of `invalidations`, a second connection that this subscribes to it. They are applied as `invalidations`
+   * handles its messages, so it must be subscribing (e.g. with `beginSubscribing()` and `pollSubscriptions()`)
+   * for the cache to be kept coherent; its callbacks never see them.
+   * @param cache The cache to use; it must outlive its use by both connections.
+   * @param invalidations A connection to the same server, not yet subscribing.
+   * @return `true` if the server enabled tracking.
+   */
+  bool enableClientCache(RedisClientCache &cache, Redis &invalidations);
+
+  /**
+   * Stop using the cache given to `enableClientCache()`, and turn off CLIENT TRACKING. With invalidations
+   * redirected, their connection is unsubscribed from `__redis__:invalidate` and no longer applies them.
+   * The cache is left as it was, but may no longer be coherent.
+   */
+  void disableClientCache();
+
+  /**
+   * Write `command` with arguments `args`, and return at once rather than waiting for its reply, which `poll()`
+   * hands to `callback` once it has arrived. Replies complete in the order their commands were issued.
+   * A synchronous command (any other method) issued while replies are outstanding first waits for them all.
+   * @param command The command name, e.g. "HINCRBY".
+   * @param args The command's arguments.
+   * @param callback Called with the reply, or with a `RedisInternalError` should the connection be lost first;
+   * `nullptr` to ignore it.
+   * @param context Passed to `callback`.
+   * @return `false`, without `callback` ever being called, if the connection is not established.
+   */
+  bool issueAsync(const String &command, const std::vector<String> &args, RedisReplyCallback callback, void *context = nullptr);
+
+  /** As `issueAsync()`, for GET `key` */
+  bool getAsync(const char *key, RedisReplyCallback callback, void *context = nullptr);
+
+  /** As `issueAsync()`, for SET `key` `value` */
+  bool setAsync(const char *key, const char *value, RedisReplyCallback callback = nullptr, void *context = nullptr);
+
+  /** As `issueAsync()`, for PUBLISH `message` to `channel` */
+  bool publishAsync(const char *channel, const char *message, RedisReplyCallback callback = nullptr, void *context = nullptr);
+
+  /**
+   * Complete each outstanding reply that has arrived, without waiting on any that hasn't: call from `loop()`.
+   * Costs no more than a call to `available()` while nothing has.
+   * @return The number of replies completed.
+   */
+  size_t poll();
+
+  /** @return The number of replies to commands issued asynchronously yet to be completed */
+  size_t pending() const { return pendingReplies.size(); }
+
+  /** Wait for every outstanding reply, completing each in turn */
+  void wait();
+
   /**
    * Set `key` to `value`.
    * @note Current implementation only supports basic SET without behavioral
@@ -124,6 +337,15 @@ public:
    */
   bool set(const char *key, const char *value);
 
+  /**
+   * Set `key` to the `len` bytes at `value`, which may contain any byte values including NUL.
+   * @param key The key name to set
+   * @param value The value to set for `key`
+   * @param len The length of `value` in bytes
+   * @return `true` if `key` was set to `value`, false if error.
+   */
+  bool set(const char *key, const uint8_t *value, size_t len);
+
   /**
    * Get `key`.
    * @param key The key name to retrieve.
@@ -131,6 +353,32 @@ public:
    */
   String get(const char *key);
 
+  /**
+   * Get `key` into a caller-supplied buffer. A value that fits is read directly into `buf`
+   * without an intermediate copy. The value is not NUL-terminated.
+   * @param key The key name to retrieve.
+   * @param buf Where to write the value.
+   * @param cap The capacity of `buf` in bytes; at most this many bytes are written.
+   * @return The full length of the value (which may exceed `cap`, in which case it was truncated),
+   * -1 if the key does not exist, or -2 on error.
+   */
+  int get(const char *key, uint8_t *buf, size_t cap);
+
+  /**
+   * Get the values of all `keys` in a single command, e.g. `mget({"a", "b", "c"})`.
+   * @param keys The key names to retrieve.
+   * @return The value of each key, in the order given, with "(nil)" for each that does not exist.
+   * Use `isNilReturn()` to check for the latter in a future-proof way.
+   */
+  std::vector<String> mget(const std::vector<String> &keys);
+
+  /**
+   * Set each key to its value in a single command, e.g. `mset({{"a", "1"}, {"b", "2"}})`.
+   * @param keysAndValues The key names and the value to set for each.
+   * @return `true` if the keys were set, false if error.
+   */
+  bool mset(const std::vector<std::pair<String, String>> &keysAndValues);
+
   /**
    * Delete `key`.
    * @param key
@@ -138,6 +386,20 @@ public:
    */
   bool del(const char *key);
 
+  /**
+   * Delete all `keys` in a single command.
+   * @param keys
+   * @return The number of keys removed.
+   */
+  int del(const std::vector<String> &keys);
+
+  /**
+   * As `del()`, but reclaims the keys' memory in the background on the server.
+   * @param keys
+   * @return The number of keys removed.
+   */
+  int unlink(const std::vector<String> &keys);
+
   /**
    * Determine if `key` exists.
    * @param key
@@ -145,6 +407,13 @@ public:
    */
   bool exists(const char *key);
 
+  /**
+   * Count how many of `keys` exist, in a single command.
+   * @param keys
+   * @return The number of `keys` that exist (a key given more than once is counted each time).
+   */
+  int exists(const std::vector<String> &keys);
+
   /**
    * Appends `value` to `key`.
    * @param key
@@ -153,6 +422,19 @@ public:
    */
   int append(const char *key, const char *value);
 
+  /**
+   * Increment the integer stored at `key` by `increment` (INCR, or INCRBY), starting from 0 if `key` DNE.
+   * @return The value after the increment, in full 64 bits; or a RedisResultError status if `key` doesn't hold
+   * an integer, or the increment would overflow.
+   */
+  RedisResult<int64_t> incr(const char *key, int64_t increment = 1);
+
+  /**
+   * Increment the number stored at `key` by `increment` (INCRBYFLOAT), starting from 0 if `key` DNE.
+   * @return The value after the increment; or a RedisResultError status if `key` doesn't hold a number.
+   */
+  RedisResult<double> incrbyfloat(const char *key, double increment);
+
   /**
    * Publish `message` to `channel`.
    * @param channel The channel on which to publish the message.
@@ -161,6 +443,12 @@ public:
    */
   int publish(const char *channel, const char *message);
 
+  /**
+   * Publish `message` to the sharded `shardChannel` (Redis 7 and later), for subscribers set up by `ssubscribe()`.
+   * @return The number of subscribers to the published message.
+   */
+  int spublish(const char *shardChannel, const char *message);
+
   /**
    * Expire a `key` in `seconds`.
    * @param key The key name for which to set expire time.
@@ -205,10 +493,17 @@ public:
   /**
    * Query remaining time-to-live (time-until-expiry) for `key`.
    * @param key The query whose TTL to query.
-   * @return The key`s TTL in milliseconds, or a negative value signaling error:
-   *   -1 if the key exists but has no associated expire, -2 if the key DNE.
+   * @return The key`s TTL in milliseconds, in full 64 bits (it may well exceed 2^31, some 24 days), or a negative
+   *   value signaling error: -1 if the key exists but has no associated expire, -2 if the key DNE.
+   *   Should the command itself fail, the library's usual error value; see `pttlResult()` to tell that apart.
+   */
+  int64_t pttl(const char *key);
+
+  /**
+   * As `pttl()`, but with a status other than RedisResultOk should the command fail, rather than a value that
+   * could also be a TTL.
    */
-  int pttl(const char *key) { return _ttl_(key, "PTTL"); }
+  RedisResult<int64_t> pttlResult(const char *key);
 
   /**
    * Query remaining time-to-live (time-until-expiry) for `key`.
@@ -227,6 +522,14 @@ public:
    */
   bool hset(const char *key, const char *field, const char *value) { return _hset_(key, field, value, "HSET"); }
 
+  /**
+   * Set each field in hash at `key` to its value in a single command, e.g. `hset(key, {{"f1", "1"}, {"f2", "2"}})`.
+   * @param key
+   * @param fieldsAndValues The field names and the value to set for each.
+   * @return The number of fields that were added (not those that were updated).
+   */
+  int hset(const char *key, const std::vector<std::pair<String, String>> &fieldsAndValues);
+
   /**
    * Set `field` in hash at `key` to `value` i.f.f. `field` does not yet exist.
    * @param key
@@ -244,6 +547,15 @@ public:
    */
   String hget(const char *key, const char *field);
 
+  /**
+   * Gets each of `fields` stored in hash at `key`, in a single command.
+   * @param key
+   * @param fields
+   * @return The value of each field, in the order given, with "(nil)" for each that does not exist.
+   * Use `isNilReturn()` to check for the latter in a future-proof way.
+   */
+  std::vector<String> hmget(const char *key, const std::vector<String> &fields);
+
   /**
    * Delete the `field` stored in hash at `key`.
    * @param key
@@ -321,6 +633,13 @@ public:
    */
   std::vector<String> lrange(const char *key, int start, int stop);
 
+  /**
+   * As above, but hands each element to `visitor` as soon as it has been read rather than holding
+   * the whole range in memory, so that lists far larger than the free heap can be read.
+   * @return The number of elements in the range, or -1 on error.
+   */
+  int lrange(const char *key, int start, int stop, RedisVisitor &visitor);
+
   /** Removes the first `count` occurrences of elements equal to `element` from the list stored at `key`.
    *  @param key
    *  @param count if less than zero: removes elements moving from head to tail; if greater than zero, removes from tail to head. if zero, removes all.
@@ -359,20 +678,113 @@ public:
    */
   int rpush(const char *key, const char *value, bool exclusive = false);
 
+  /**
+   * Add each of `members` to the sorted set at `key` with its score, or update its score, in a single command,
+   * e.g. `zadd(key, {{"reading:1", 1700000000}, {"reading:2", 1700000060}})`.
+   * @param condition Any of ZADD's options, e.g. "NX" to only add new members, or "GT" to only raise scores.
+   * @return The number of members added (not those updated).
+   */
+  int zadd(const char *key, const std::vector<RedisScoredMember> &members, const char *condition = nullptr);
+
+  /**
+   * Increment the score of `member` in the sorted set at `key` by `increment`, adding it if absent.
+   * @return The member's new score, or NAN on error.
+   */
+  double zincrby(const char *key, double increment, const char *member);
+
+  /**
+   * Returns the number of members of the sorted set at `key` (0 if `key` DNE).
+   */
+  int zcard(const char *key);
+
+  /**
+   * Returns the members of the sorted set at `key` between `start` and `stop`, inclusive, with their scores.
+   * The range is selected on the server, so that only its members are sent, e.g. the readings of the last hour:
+   * `zrange(key, String(now - 3600).c_str(), "+inf", RedisZRangeByScore)`.
+   * @param by Whether `start` and `stop` are ranks, scores or members (see RedisZRangeBy).
+   * @param rev `true` for the members in descending order, from `start` (then the higher bound) down to `stop`.
+   * @param offset,count With RedisZRangeByScore or RedisZRangeByLex, skip the first `offset` members of the
+   * range and return no more than `count` (LIMIT); a negative `count` returns all that remain.
+   * @return The members in order; or an empty vector if error/DNE. A range by lex has no scores (they are 0).
+   */
+  std::vector<RedisScoredMember> zrange(const char *key, const char *start, const char *stop,
+                                        RedisZRangeBy by = RedisZRangeByRank, bool rev = false,
+                                        int offset = 0, int count = -1);
+
+  /**
+   * As `zrange()`, but stores the range as the sorted set at `dst` (replacing it) rather than returning it.
+   * @return The number of members stored.
+   */
+  int zrangestore(const char *dst, const char *src, const char *start, const char *stop,
+                  RedisZRangeBy by = RedisZRangeByRank, bool rev = false, int offset = 0, int count = -1);
+
+  /**
+   * Removes the members of the sorted set at `key` whose scores lie between `min` and `max` (as for
+   * RedisZRangeByScore), e.g. to expire readings older than a day: `zremrangebyscore(key, "-inf", cutoff)`.
+   * @return The number of members removed.
+   */
+  int zremrangebyscore(const char *key, const char *min, const char *max);
+
+  /**
+   * Removes and returns up to `count` members with the lowest scores from the sorted set at `key`.
+   * @return The members removed, lowest first; or an empty vector if error/DNE.
+   */
+  std::vector<RedisScoredMember> zpopmin(const char *key, unsigned int count = 1);
+
+  /**
+   * As `zpopmin()` for a single member of the first non-empty of the sorted sets at `keys`, waiting for up to
+   * `timeout` seconds (0 for indefinitely) for a member to be added should they all be empty. Blocks meanwhile.
+   * @param popped Receives the member removed, and its score.
+   * @param from If not `nullptr`, receives the key of the sorted set from which it was removed.
+   * @return `true` if a member was removed; `false` if `timeout` elapsed or on error.
+   */
+  bool bzpopmin(const std::vector<String> &keys, double timeout, RedisScoredMember &popped, String *from = nullptr);
+
   /**
    * Sets up a subscription for messages published to `channel`. May be called in any mode & from message handlers.
+   * In subscription mode, the subscription is sent without waiting for its confirmation, which is consumed as messages are.
+   * @return `true` if the subscription was set up (or, in subscription mode, sent).
+   */
+  bool subscribe(const char *channel) { return _subscribe(SubscribeChannel, {String(channel)}); }
+
+  /**
+   * Sets up subscriptions to each of `channels`, as `subscribe()` does, but with a single command for them all.
    */
-  bool subscribe(const char *channel) { return _subscribe(SubscribeSpec{false, String(channel)}); }
+  bool subscribe(const std::vector<String> &channels) { return _subscribe(SubscribeChannel, channels); }
 
   /**
    * Sets up a subscription for messages published to any channels matching `pattern`. May be called in any mode & from message handlers.
    */
-  bool psubscribe(const char *pattern) { return _subscribe(SubscribeSpec{true, String(pattern)}); }
+  bool psubscribe(const char *pattern) { return _subscribe(SubscribePattern, {String(pattern)}); }
+
+  /**
+   * Sets up subscriptions to each of `patterns`, as `psubscribe()` does, but with a single command for them all.
+   */
+  bool psubscribe(const std::vector<String> &patterns) { return _subscribe(SubscribePattern, patterns); }
+
+  /**
+   * Sets up a subscription for messages published to the sharded `shardChannel` with `spublish()` (Redis 7 and later).
+   * May be called in any mode & from message handlers.
+   */
+  bool ssubscribe(const char *shardChannel) { return _subscribe(SubscribeShard, {String(shardChannel)}); }
+
+  /**
+   * Sets up subscriptions to each of `shardChannels`, as `ssubscribe()` does. As each may belong to a different
+   * cluster slot, they are sent as one command apiece, but all written at once.
+   */
+  bool ssubscribe(const std::vector<String> &shardChannels) { return _subscribe(SubscribeShard, shardChannels); }
+
+  /**
+   * Removes a subscription for `channelOrPattern`, whether it was set up by `subscribe()`, `psubscribe()` or `ssubscribe()`.
+   * May be called from message handlers, and (as `subscribe()` does) does not wait for the confirmation.
+   * @return In subscription mode, `true` if the unsubscription was sent; otherwise, `true` if the subscription had been set up.
+   */
+  bool unsubscribe(const char *channelOrPattern) { return unsubscribe(std::vector<String>{String(channelOrPattern)}); }
 
   /**
-   * Removes a subscription for `channelOrPattern`. May be called from message handlers.
+   * Removes the subscriptions for each of `channelsOrPatterns`, as `unsubscribe()` does, with one command for each kind.
    */
-  bool unsubscribe(const char *channelOrPattern);
+  bool unsubscribe(const std::vector<String> &channelsOrPatterns);
 
   /**
    * Append a sample to a time series.
@@ -403,6 +815,13 @@ public:
   String xadd(const char *key, const char *id, const char *field,
               const char *value);
 
+  /**
+   * Appends the specified stream entry, whose value is the `len` bytes at `value`,
+   * to the stream stored at `key`.
+   */
+  String xadd(const char *key, const char *id, const char *field,
+              const uint8_t *value, size_t len);
+
   /**
    * Transfers ownership of pending stream entries that match the criteria.
    * It is equivalent to calling XPENDING and then XCLAIM
@@ -551,6 +970,20 @@ public:
   std::vector<String> xrange(const char *key, const char *start,
                              const char *end, unsigned int count);
 
+  /**
+   * As `xrange()`, but returns the entries themselves rather than flattening them to strings.
+   */
+  RedisStreamEntries xrange_entries(const char *key, const char *start,
+                                    const char *end, unsigned int count);
+
+  /**
+   * As `xrange()`, but calls `callback` with each entry as soon as it has been read, so that only
+   * one entry at a time is held in memory however many are returned.
+   * @return The number of entries read, or -1 on error.
+   */
+  int xrange_entries(const char *key, const char *start, const char *end,
+                     unsigned int count, RedisStreamEntryCallback callback);
+
   /**
    * Read data from one stream, only returning entries with an ID greater than
    * the last received ID reported by the caller
@@ -560,6 +993,20 @@ public:
   std::vector<String> xread(unsigned int count, unsigned int block,
                             const char *key, const char *id);
 
+  /**
+   * As `xread()`, but returns the entries themselves rather than flattening them to strings.
+   * Empty if `block` elapsed without any entry arriving.
+   */
+  RedisStreamEntries xread_entries(unsigned int count, unsigned int block,
+                                   const char *key, const char *id);
+
+  /**
+   * As `xread()`, but calls `callback` with each entry as soon as it has been read.
+   * @return The number of entries read, or -1 on error.
+   */
+  int xread_entries(unsigned int count, unsigned int block, const char *key,
+                    const char *id, RedisStreamEntryCallback callback);
+
   /**
    * XREAD version supporting groups
    * @param group
@@ -574,6 +1021,21 @@ public:
                                  unsigned int count, unsigned int block_ms, bool noack, const char *key,
                                  const char *id);
 
+  /**
+   * As `xreadgroup()`, but returns the entries themselves rather than flattening them to strings.
+   */
+  RedisStreamEntries xreadgroup_entries(const char *group, const char *consumer,
+                                        unsigned int count, unsigned int block_ms, bool noack,
+                                        const char *key, const char *id);
+
+  /**
+   * As `xreadgroup()`, but calls `callback` with each entry as soon as it has been read.
+   * @return The number of entries read, or -1 on error.
+   */
+  int xreadgroup_entries(const char *group, const char *consumer, unsigned int count,
+                         unsigned int block_ms, bool noack, const char *key, const char *id,
+                         RedisStreamEntryCallback callback);
+
   /**
    * Returns a range with entries in reverse order
    * @param key
@@ -584,6 +1046,19 @@ public:
   std::vector<String> xrevrange(const char *key, const char *end,
                                 const char *start, unsigned int count);
 
+  /**
+   * As `xrevrange()`, but returns the entries themselves rather than flattening them to strings.
+   */
+  RedisStreamEntries xrevrange_entries(const char *key, const char *end,
+                                       const char *start, unsigned int count);
+
+  /**
+   * As `xrevrange()`, but calls `callback` with each entry as soon as it has been read.
+   * @return The number of entries read, or -1 on error.
+   */
+  int xrevrange_entries(const char *key, const char *end, const char *start,
+                        unsigned int count, RedisStreamEntryCallback callback);
+
   /**
    * Trims the stream by evicting older entries if needed
    * @param key
@@ -616,16 +1091,46 @@ public:
    * On success, this call will *block* until stopSubscribing() is called (meaning `loop()` will never be called!), and only *then* will return `RedisSubscribeSuccess`.
    * On remote disconnect, this call will end with the return value `RedisSubscribeServerDisconnected`, which is generally non-fatal.
    * On failure, this call will return immediately with a return value indicated the failure mode.
-   * Calling `stopSubscribing()` will force this method to exit on the *next* recieved message.
-   * @param messageCallback The function to be called on each successful message receipt.
+   * Calling `stopSubscribing()` will force this method to exit once the message being handled (if any) has been.
+   * @param messageCallback The function to be called on each successful message receipt: either a `RedisMsgCallback`, or a
+   * `RedisMsgViewCallback` to receive it (with the matched pattern) without it being copied.
    * @param errorCallback The function to be called if message receipt processing produces an error. Call `stopSubscribing()` on
    * the passed-in instance to end all further message processing.
    */
   RedisSubscribeResult startSubscribing(RedisMsgCallback messageCallback, RedisMsgErrorCallback errorCallback = nullptr);
+  RedisSubscribeResult startSubscribing(RedisMsgViewCallback messageCallback, RedisMsgErrorCallback errorCallback = nullptr);
   RedisSubscribeResult startSubscribingNonBlocking(RedisMsgCallback messageCallback, LoopCallback loopCallback, RedisMsgErrorCallback errorCallback = nullptr);
+  RedisSubscribeResult startSubscribingNonBlocking(RedisMsgViewCallback messageCallback, LoopCallback loopCallback, RedisMsgErrorCallback errorCallback = nullptr);
 
   /**
-   * Stops message processing on receipt of next message. Can be called from message handlers.
+   * Sets how `startSubscribing()` & `startSubscribingNonBlocking()` wait between messages. Either way, a message is only
+   * parsed once `Client::available()` reports its bytes have arrived, and `loopCallback` is called once per wait.
+   * @param strategy The idle strategy; `RedisIdleYield` by default.
+   * @param maxDelayMs For `RedisIdleBackoff`, the longest single wait, which bounds the latency added to a message.
+   */
+  void setSubscriberIdle(RedisIdleStrategy strategy, unsigned long maxDelayMs = 50)
+  {
+    subIdle = strategy;
+    subIdleMaxDelay = maxDelayMs;
+  }
+
+  /**
+   * Enters subscription mode as `startSubscribing()` does, but returns immediately: messages are then handled
+   * by calling `pollSubscriptions()` from the application's own loop or scheduler.
+   * @return `RedisSubscribeSuccess`, or the failure mode as `startSubscribing()` would return it.
+   */
+  RedisSubscribeResult beginSubscribing(RedisMsgCallback messageCallback, RedisMsgErrorCallback errorCallback = nullptr);
+  RedisSubscribeResult beginSubscribing(RedisMsgViewCallback messageCallback, RedisMsgErrorCallback errorCallback = nullptr);
+
+  /**
+   * Handles every message that has fully arrived since the last call, without blocking: a message that has only partly
+   * arrived is kept and completed by a later call. Does nothing after `stopSubscribing()`.
+   * @return `RedisSubscribeSuccess` to keep polling; otherwise (e.g. `RedisSubscribeServerDisconnected`) subscription has ended.
+   */
+  RedisSubscribeResult pollSubscriptions();
+
+  /**
+   * Stops message processing once the message being handled (if any) has been. Can be called from message handlers.
    */
   void stopSubscribing() { subLoopRun = false; }
 
@@ -636,22 +1141,73 @@ public:
   const void *getTestContext() { return _test_context; }
 
 private:
+  friend class RedisPipeline;
+  friend class RedisConnection;
+  friend class RedisTransaction;
+  friend class RedisScript;
+  friend class RedisFunction;
+
+  typedef enum
+  {
+    SubscribeChannel,
+    SubscribePattern,
+    SubscribeShard,
+  } SubscribeKind;
+
   typedef struct
   {
-    bool pattern;
+    SubscribeKind kind;
     String spec;
   } SubscribeSpec;
 
-  bool _subscribe(SubscribeSpec spec);
+  bool _subscribe(SubscribeKind kind, const std::vector<String> &specs);
+  RedisSubscribeResult _beginSubscribing(RedisMsgErrorCallback errCallback);
+  RedisSubscribeResult _subscriberLoop(LoopCallback loopCallback);
+  RedisSubscribeResult _dispatchMessage(std::shared_ptr<RedisObject> msg);
+  static void _routePush(std::shared_ptr<RedisObject> push, void *context);
+  void _invalidate(std::shared_ptr<RedisObject> keys);
+  void _endRedirect();
+  String _cachedGet(const char *key, const char *field);
+  RedisReturnValue _restore(const char *password, int database);
+  bool _issueAsync(std::initializer_list<RedisArg> cmdAndArgs, RedisReplyCallback callback, void *context);
+  void _complete(std::shared_ptr<RedisObject> reply);
+  static void _waitPending(void *context);
 
   Client &conn;
+  std::unique_ptr<RedisReader> reader;
+  // every subscription set up and not since removed, (re)sent by each beginSubscribing()
   std::vector<SubscribeSpec> subSpec;
   bool subscriberMode = false;
   bool subLoopRun = false;
+  RedisMsgCallback subMsgCallback = nullptr;
+  RedisMsgViewCallback subMsgViewCallback = nullptr;
+  RedisMsgErrorCallback subErrCallback = nullptr;
+  RedisPushCallback pushCallback = nullptr;
+  bool resp3 = false;
+  // serves get() & hget(); and, separately, has invalidations applied to it (the same cache unless redirected)
+  RedisClientCache *cache = nullptr;
+  RedisClientCache *invalidatedCache = nullptr;
+  typedef struct
+  {
+    RedisReplyCallback callback;
+    void *context;
+  } PendingReply;
+
+  // for commands issued asynchronously, in the order they were
+  std::deque<PendingReply> pendingReplies;
+  // the connection whose invalidations are redirected here, if any; and that to which this redirects its own
+  Redis *redirectedFrom = nullptr;
+  Redis *redirectedTo = nullptr;
+  RedisIdleStrategy subIdle = RedisIdleYield;
+  unsigned long subIdleMaxDelay = 50;
 
   bool _expire_(const char *, int, const char *);
   int _ttl_(const char *, const char *);
   bool _hset_(const char *, const char *, const char *, const char *);
+  std::shared_ptr<RedisObject> _xrange_(const char *, const char *, const char *, const char *, unsigned int);
+  std::shared_ptr<RedisObject> _xread_(unsigned int, unsigned int, const char *, const char *);
+  std::shared_ptr<RedisObject> _xreadgroup_(const char *, const char *, unsigned int, unsigned int, bool,
+                                            const char *, const char *);
 
   const void *_test_context;
 };
@@ -0,0 +1,202 @@
+#include "RedisClientCache.h"
+
+// FNV-1a, continuing from `hash`
+static uint32_t fnv1a(const char *buf, size_t len, uint32_t hash = 2166136261u)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    hash = (hash ^ (uint8_t)buf[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// a field, if any, is hashed after the key and a separator no key can end with, so that
+// ("ab", "c") and ("a", "bc") differ, as do the GET of a key and the HGET of an empty field
+static uint32_t entryHash(uint32_t keyHash, const char *field)
+{
+  return field ? fnv1a(field, strlen(field), fnv1a("\0", 1, keyHash)) : keyHash;
+}
+
+// as slots are linked by int16_t indices, and hold uint16_t lengths
+#define MaxEntries 32767
+#define MaxEntryBytes 65535
+
+RedisClientCache::RedisClientCache(size_t entries, size_t entryBytes)
+    : _entries(entries < MaxEntries ? entries : MaxEntries),
+      _entryBytes(entryBytes < MaxEntryBytes ? entryBytes : MaxEntryBytes)
+{
+  _slots = new Slot[_entries]();
+  _pool = new uint8_t[_entries * _entryBytes];
+}
+
+RedisClientCache::~RedisClientCache()
+{
+  delete[] _slots;
+  delete[] _pool;
+}
+
+int RedisClientCache::find(const char *key, const char *field, uint32_t hash) const
+{
+  auto keyLen = strlen(key);
+  auto fieldLen = field ? strlen(field) : 0;
+  for (size_t i = 0; i < _entries; i++)
+  {
+    auto &slot = _slots[i];
+    if (slot.used && slot.hash == hash && slot.keyLen == keyLen && slot.hasField == (field != nullptr) &&
+        slot.fieldLen == fieldLen && !memcmp(bytes(i), key, keyLen) && (!field || !memcmp(bytes(i) + keyLen, field, fieldLen)))
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void RedisClientCache::unlink(int slot)
+{
+  auto &s = _slots[slot];
+  (s.prev >= 0 ? _slots[s.prev].next : _head) = s.next;
+  (s.next >= 0 ? _slots[s.next].prev : _tail) = s.prev;
+  s.prev = s.next = -1;
+}
+
+void RedisClientCache::pushFront(int slot)
+{
+  auto &s = _slots[slot];
+  s.prev = -1;
+  s.next = _head;
+  (_head >= 0 ? _slots[_head].prev : _tail) = slot;
+  _head = slot;
+}
+
+void RedisClientCache::drop(int slot)
+{
+  unlink(slot);
+  _slots[slot].used = false;
+  _used--;
+}
+
+bool RedisClientCache::lookup(const char *key, const char *field, String &value)
+{
+  auto slot = find(key, field, entryHash(fnv1a(key, strlen(key)), field));
+  if (slot < 0)
+  {
+    _misses++;
+    return false;
+  }
+
+  auto &s = _slots[slot];
+  value = String();
+  value.concat((const char *)bytes(slot) + s.keyLen + s.fieldLen, s.valueLen);
+  if (_head != slot)
+  {
+    unlink(slot);
+    pushFront(slot);
+  }
+  _hits++;
+  return true;
+}
+
+void RedisClientCache::store(const char *key, const char *field, const String &value)
+{
+  auto keyLen = strlen(key);
+  auto fieldLen = field ? strlen(field) : 0;
+  if (!_entries || keyLen + fieldLen + value.length() > _entryBytes)
+  {
+    return;
+  }
+
+  auto keyHash = fnv1a(key, keyLen);
+  auto hash = entryHash(keyHash, field);
+  auto slot = find(key, field, hash);
+  if (slot >= 0)
+  {
+    unlink(slot);
+  }
+  else
+  {
+    for (size_t i = 0; i < _entries && slot < 0; i++)
+    {
+      if (!_slots[i].used)
+      {
+        slot = i;
+      }
+    }
+
+    if (slot < 0)
+    {
+      slot = _tail;
+      unlink(slot);
+      _evictions++;
+    }
+    else
+    {
+      _used++;
+    }
+  }
+
+  auto &s = _slots[slot];
+  s.hash = hash;
+  s.keyHash = keyHash;
+  s.keyLen = keyLen;
+  s.fieldLen = fieldLen;
+  s.valueLen = value.length();
+  s.hasField = field != nullptr;
+  s.used = true;
+  memcpy(bytes(slot), key, keyLen);
+  if (field)
+  {
+    memcpy(bytes(slot) + keyLen, field, fieldLen);
+  }
+  memcpy(bytes(slot) + keyLen + fieldLen, value.c_str(), value.length());
+  pushFront(slot);
+}
+
+void RedisClientCache::reserve(const char *key, const char *field)
+{
+  _reservedKey = key;
+  _reservedField = field;
+  _reservedStale = false;
+}
+
+void RedisClientCache::fill(const String &value)
+{
+  if (_reservedKey && !_reservedStale)
+  {
+    store(_reservedKey, _reservedField, value);
+  }
+  release();
+}
+
+void RedisClientCache::invalidate(const char *key, size_t len)
+{
+  if (_reservedKey && strlen(_reservedKey) == len && !memcmp(_reservedKey, key, len))
+  {
+    _reservedStale = true;
+  }
+
+  auto keyHash = fnv1a(key, len);
+  for (size_t i = 0; i < _entries; i++)
+  {
+    auto &slot = _slots[i];
+    if (slot.used && slot.keyHash == keyHash && slot.keyLen == len && !memcmp(bytes(i), key, len))
+    {
+      drop(i);
+      _invalidations++;
+    }
+  }
+}
+
+void RedisClientCache::clear()
+{
+  for (size_t i = 0; i < _entries; i++)
+  {
+    if (_slots[i].used)
+    {
+      _invalidations++;
+    }
+    _slots[i].used = false;
+  }
+  _used = 0;
+  _head = _tail = -1;
+  _reservedStale = true;
+}
@@ -0,0 +1,112 @@
+#ifndef REDIS_CLIENT_CACHE_H
+#define REDIS_CLIENT_CACHE_H
+
+#include <Arduino.h>
+
+/** A local cache of GET and HGET replies, kept coherent by the server's invalidations (CLIENT TRACKING),
+ *  so that repeatedly reading the same keys costs a lookup in memory rather than a round trip.
+ *
+ *  Its memory is fixed: `entries` slots of `entryBytes` bytes each, allocated once up front, so the cache never
+ *  fragments the heap however much it churns. A reply whose key, field and value together don't fit a slot is simply
+ *  not cached. Once every slot is in use, the least recently read entry is evicted to make room.
+ *
+ *  Usage:
+ *  @code
+ *  RedisClientCache cache(32, 96);
+ *  redis.hello(3);
+ *  redis.enableClientCache(cache);
+ *  String mode = redis.hget("device:config", "mode"); // from the server, then from the cache until it changes
+ *  @endcode
+ *
+ *  Lookups compare a hash of each slot in turn, so suit the few dozen entries a device would cache.
+ */
+class RedisClientCache
+{
+public:
+  /**
+   * @param entries The number of entries that may be cached at once, at most 32767 (any more are not allocated).
+   * @param entryBytes The space for each entry's key, field (for HGET) and value combined, at most 65535 (likewise).
+   */
+  RedisClientCache(size_t entries = 16, size_t entryBytes = 64);
+  ~RedisClientCache();
+
+  RedisClientCache(const RedisClientCache &) = delete;
+  RedisClientCache &operator=(const RedisClientCache &) = delete;
+
+  /**
+   * Read the cached value of `key` (for GET, when `field` is `nullptr`) or of `field` of `key` (for HGET).
+   * @return `true`, with the value in `value`, on a hit.
+   */
+  bool lookup(const char *key, const char *field, String &value);
+
+  /** Cache `value` as the value of `key` (or of its `field`), if it fits */
+  void store(const char *key, const char *field, const String &value);
+
+  /**
+   * Note that `key` (or its `field`) is being read from the server, so that an invalidation of it arriving before
+   * the reply (as one redirected to another connection may) is not lost: `fill()` then leaves it uncached.
+   * `key` and `field` must outlive the read.
+   */
+  void reserve(const char *key, const char *field);
+
+  /** Cache `value` as that of the key (or field) `reserve()`d, unless it has been invalidated meanwhile */
+  void fill(const String &value);
+
+  /** Forget the key (or field) `reserve()`d without caching it, e.g. as the server replied with an error */
+  void release() { _reservedKey = nullptr; }
+
+  /** Drop every entry for `key` (of `len` bytes), its fields included, as the server's invalidation of it requires */
+  void invalidate(const char *key, size_t len);
+
+  /** Drop every entry, as the server requires when it can no longer track keys (e.g. after a reconnection) */
+  void clear();
+
+  /** @return The number of entries cached */
+  size_t size() const { return _used; }
+
+  unsigned long hits() const { return _hits; }
+  unsigned long misses() const { return _misses; }
+  /** @return The number of entries dropped to make room for others */
+  unsigned long evictions() const { return _evictions; }
+  /** @return The number of entries dropped on the server's invalidation */
+  unsigned long invalidations() const { return _invalidations; }
+
+private:
+  typedef struct
+  {
+    uint32_t hash;    // of key and field
+    uint32_t keyHash; // of key alone, to find every field of a key
+    uint16_t keyLen;
+    uint16_t fieldLen;
+    uint16_t valueLen;
+    int16_t prev; // towards the most recently read
+    int16_t next; // towards the least recently read
+    bool used;
+    bool hasField;
+  } Slot;
+
+  int find(const char *key, const char *field, uint32_t hash) const;
+  uint8_t *bytes(int slot) const { return _pool + (size_t)slot * _entryBytes; }
+  void unlink(int slot);
+  void pushFront(int slot);
+  void drop(int slot);
+
+  Slot *_slots;
+  uint8_t *_pool;
+  size_t _entries;
+  size_t _entryBytes;
+  size_t _used = 0;
+  int16_t _head = -1; // most recently read
+  int16_t _tail = -1; // least recently read
+  // being read by reserve(); and whether it has been invalidated since
+  const char *_reservedKey = nullptr;
+  const char *_reservedField = nullptr;
+  bool _reservedStale = false;
+
+  unsigned long _hits = 0;
+  unsigned long _misses = 0;
+  unsigned long _evictions = 0;
+  unsigned long _invalidations = 0;
+};
+
+#endif // REDIS_CLIENT_CACHE_H
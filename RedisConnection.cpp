@@ -0,0 +1,89 @@
+#include "RedisConnection.h"
+#include "RedisInternal.h"
+
+// Commands with the same effect, and reply, however many times they are applied
+static const char *idempotentCommands[] = {
+    "GET", "MGET", "HGET", "HMGET", "HGETALL", "HEXISTS", "HLEN", "HKEYS", "HVALS", "HSTRLEN",
+    "EXISTS", "TTL", "PTTL", "STRLEN", "TYPE", "KEYS", "LRANGE", "LLEN", "LINDEX", "XRANGE",
+    "XREVRANGE", "XLEN", "INFO", "PING"};
+
+static bool isIdempotent(const char *command, size_t len)
+{
+  for (auto idempotent : idempotentCommands)
+  {
+    if (strlen(idempotent) == len && !strncasecmp(idempotent, command, len))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+RedisConnection::RedisConnection(Client &client, const char *host, uint16_t port)
+    : _client(client), _host(host), _port(port), _redis(client)
+{
+  _redis.reader->setDisconnectHandler(onDisconnect, this);
+}
+
+RedisConnection::~RedisConnection()
+{
+  _redis.reader->setDisconnectHandler(nullptr, nullptr);
+}
+
+bool RedisConnection::connect()
+{
+  _failures = 0;
+  return attempt();
+}
+
+bool RedisConnection::maintain()
+{
+  return _client.connected() || reconnect();
+}
+
+bool RedisConnection::reconnect()
+{
+  // the first attempt after a loss is made at once; each that fails waits out a backoff before the next
+  if (_restoring || (_failures && millis() - _lastAttempt < _wait) || !attempt())
+  {
+    return false;
+  }
+
+  _reconnects++;
+  return true;
+}
+
+bool RedisConnection::attempt()
+{
+  _restoring = true;
+  _lastAttempt = millis();
+  _client.stop();
+  // 1 on success; a failure may be 0 or, as with EthernetClient, a negative code
+  _lastFailure = _client.connect(_host.c_str(), _port) == 1 ? _redis._restore(_password.c_str(), _database)
+                                                            : RedisNotConnectedFailure;
+  _restoring = false;
+
+  if (_lastFailure == RedisSuccess)
+  {
+    _failures = 0;
+    return true;
+  }
+
+  _client.stop();
+  auto shift = _failures < 16 ? _failures : 16;
+  auto ceiling = _backoffMin << shift;
+  ceiling = ceiling < _backoffMax && ceiling >= _backoffMin ? ceiling : _backoffMax;
+  _wait = ceiling / 2 + random(ceiling / 2 + 1);
+  _failures++;
+  return false;
+}
+
+bool RedisConnection::onDisconnect(const char *command, size_t len, void *context)
+{
+  auto connection = (RedisConnection *)context;
+  if (!connection->reconnect())
+  {
+    return false;
+  }
+  return !command || (connection->_retryIdempotent && isIdempotent(command, len));
+}
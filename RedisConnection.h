@@ -0,0 +1,117 @@
+#ifndef REDIS_CONNECTION_H
+#define REDIS_CONNECTION_H
+
+#include "Redis.h"
+
+/** A Redis connection that restores itself: once the connection is found lost (e.g. after a Wi-Fi access point
+ *  handover), it is reconnected straight away, and then with jittered exponential backoff for as long as that fails.
+ *  Each new connection is brought back to the state of the last: authenticated, in the same protocol (see
+ *  `Redis::hello()`) and database, and with every subscription re-subscribed, so a subscriber carries on receiving
+ *  messages rather than returning `RedisSubscribeServerDisconnected`. Messages published while disconnected are lost.
+ *  Client-side caching (see `Redis::enableClientCache()`) is re-enabled, its cache cleared, when its invalidations
+ *  come to the same connection under RESP3; if they were redirected to another connection, caching is disabled
+ *  instead (whichever of the two was lost), and must be enabled again by the sketch.
+ *
+ *  Usage:
+ *  @code
+ *  WiFiClient client;
+ *  RedisConnection connection(client, "redis.local");
+ *  connection.setPassword("secret");
+ *  connection.setRetryIdempotent(true);
+ *  if (connection.connect())
+ *  {
+ *    Redis &redis = connection.redis();
+ *    redis.get("config"); // issued again on a new connection should this one have been lost
+ *  }
+ *  @endcode
+ *
+ *  A command that finds the connection lost fails with `RedisInternalError::Disconnected` as before (unless it may be
+ *  retried), but the next is issued on a new connection. A sketch issuing no commands for a while can call
+ *  `maintain()` from `loop()` to reconnect in the meantime.
+ */
+class RedisConnection
+{
+public:
+  /**
+   * @param client The Client to connect, and reconnect, to `host`:`port`; it must outlive this.
+   * @param host The Redis server's host name or address; copied.
+   * @param port The Redis server's port.
+   */
+  RedisConnection(Client &client, const char *host, uint16_t port = 6379);
+  ~RedisConnection();
+
+  RedisConnection(const RedisConnection &) = delete;
+  RedisConnection &operator=(const RedisConnection &) = delete;
+
+  /** Authenticate each new connection with `password` */
+  void setPassword(const char *password) { _password = password; }
+
+  /** SELECT `database` on each new connection */
+  void setDatabase(int database) { _database = database; }
+
+  /**
+   * Wait between failed attempts to reconnect, from `minMs` doubling up to `maxMs`, each wait chosen at random from
+   * the upper half of the range so that many devices losing the server at once don't all return at once.
+   */
+  void setBackoff(unsigned long minMs, unsigned long maxMs)
+  {
+    _backoffMin = minMs;
+    _backoffMax = maxMs;
+  }
+
+  /**
+   * Issue read-only commands (e.g. GET, HGET, LRANGE, XRANGE) once more on the new connection when they found the
+   * old one lost, rather than failing them. Other commands are not retried, as they may have been applied before the
+   * connection was lost: even SET, which applied again could undo another client's write in between. Off by default.
+   */
+  void setRetryIdempotent(bool retry) { _retryIdempotent = retry; }
+
+  /**
+   * Connect, and set up the new connection as described above.
+   * @return `true` if connected.
+   */
+  bool connect();
+
+  /**
+   * Reconnect now if the connection is lost and the backoff allows.
+   * @return `true` if connected.
+   */
+  bool maintain();
+
+  /** The connection's Redis instance, through which every command should be issued */
+  Redis &redis() { return _redis; }
+
+  /** @return The number of times the connection has been restored */
+  unsigned long reconnects() const { return _reconnects; }
+
+  /**
+   * @return Why the last attempt to connect failed: `RedisAuthFailure` if the server refused the password (as it
+   * will every attempt until that is changed), or `RedisNotConnectedFailure` if the server couldn't be reached or
+   * the connection's state restored; `RedisSuccess` if it didn't fail.
+   */
+  RedisReturnValue lastFailure() const { return _lastFailure; }
+
+private:
+  bool reconnect();
+  bool attempt();
+  static bool onDisconnect(const char *command, size_t len, void *context);
+
+  Client &_client;
+  String _host;
+  uint16_t _port;
+  String _password;
+  int _database = 0;
+  Redis _redis;
+
+  bool _retryIdempotent = false;
+  bool _restoring = false;
+  unsigned long _backoffMin = 100;
+  unsigned long _backoffMax = 30000;
+  unsigned int _failures = 0;
+  unsigned long _lastAttempt = 0;
+  unsigned long _wait = 0;
+  unsigned long _reconnects = 0;
+  RedisReturnValue _lastFailure = RedisSuccess;
+};
+
+#endif // REDIS_CONNECTION_H
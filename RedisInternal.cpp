@@ -1,12 +1,197 @@
 #include "RedisInternal.h"
-#include <map>
 #include <limits.h>
 #include <memory>
 
-void RedisObject::init(Client &client)
+// formats `v` as decimal digits ending just before `end`, returning a pointer to the first character
+static char *formatDecimal(char *end, unsigned long v, bool negative)
 {
-    data = client.readStringUntil('\r');
-    client.read(); // discard '\n'
+    do
+    {
+        *--end = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+
+    if (negative)
+        *--end = '-';
+    return end;
+}
+
+// as above, for values that may exceed an unsigned long (32 bits on the ESP8266 and ESP32), whose
+// 64-bit division is done in software: the digits beyond 32 bits are peeled off first, if there are any
+static char *formatDecimal(char *end, unsigned long long v, bool negative)
+{
+    while (v > (unsigned long)-1)
+    {
+        *--end = '0' + (v % 10);
+        v /= 10;
+    }
+    return formatDecimal(end, (unsigned long)v, negative);
+}
+
+RedisArg::RedisArg(long v)
+{
+    auto end = _num + sizeof(_num) - 1;
+    *end = '\0';
+    auto start = formatDecimal(end, v < 0 ? 0UL - (unsigned long)v : (unsigned long)v, v < 0);
+    _len = end - start;
+    memmove(_num, start, _len + 1);
+}
+
+RedisArg::RedisArg(unsigned long v)
+{
+    auto end = _num + sizeof(_num) - 1;
+    *end = '\0';
+    auto start = formatDecimal(end, v, false);
+    _len = end - start;
+    memmove(_num, start, _len + 1);
+}
+
+RedisArg::RedisArg(long long v)
+{
+    auto end = _num + sizeof(_num) - 1;
+    *end = '\0';
+    auto start = formatDecimal(end, v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v, v < 0);
+    _len = end - start;
+    memmove(_num, start, _len + 1);
+}
+
+RedisArg::RedisArg(unsigned long long v)
+{
+    auto end = _num + sizeof(_num) - 1;
+    *end = '\0';
+    auto start = formatDecimal(end, v, false);
+    _len = end - start;
+    memmove(_num, start, _len + 1);
+}
+
+RedisEncoder &RedisEncoder::command(std::initializer_list<RedisArg> cmdAndArgs)
+{
+    array(cmdAndArgs.size());
+    for (const auto &arg : cmdAndArgs)
+        bulk(arg);
+    return *this;
+}
+
+RedisEncoder &RedisEncoder::command(const String &cmd, const ArgList &args)
+{
+    array(args.size() + 1);
+    bulk(cmd.c_str(), cmd.length());
+    for (const auto &arg : args)
+        bulk(arg.c_str(), arg.length());
+    return *this;
+}
+
+RedisEncoder &RedisEncoder::array(size_t count)
+{
+    header((char)RedisObject::Type::Array, (long)count);
+    return *this;
+}
+
+RedisEncoder &RedisEncoder::bulk(const char *buf, size_t len)
+{
+    header((char)RedisObject::Type::BulkString, (long)len);
+    put(buf, len);
+    put("\r\n", 2);
+    return *this;
+}
+
+void RedisEncoder::header(char type, long len)
+{
+    char hdr[24];
+    auto end = hdr + sizeof(hdr) - 2;
+    end[0] = '\r';
+    end[1] = '\n';
+    auto start = formatDecimal(end, (unsigned long)len, false);
+    *--start = type;
+    put(start, (hdr + sizeof(hdr)) - start);
+}
+
+void RedisEncoder::put(const char *buf, size_t len)
+{
+    if (_overflow)
+        return;
+
+    if (_used + len > _cap)
+    {
+        if (!_out)
+        {
+            _overflow = true;
+            return;
+        }
+
+        flush();
+
+        if (len > _cap)
+        {
+            // too big to stage; hand it to the Print as-is rather than copying it in pieces
+            if (_out->write((const uint8_t *)buf, len) != len)
+                _overflow = true;
+            _total += len;
+            return;
+        }
+    }
+
+    memcpy(_buf + _used, buf, len);
+    _used += len;
+    _total += len;
+}
+
+void RedisEncoder::flush()
+{
+    if (!_out || !_used)
+        return;
+
+    if (_out->write(_buf, _used) != _used)
+        _overflow = true;
+    _used = 0;
+}
+
+int RedisReader::available()
+{
+    if (buffered())
+        return (int)buffered();
+
+    auto clientAvail = _client.available();
+    return clientAvail > 0 ? clientAvail : 0;
+}
+
+size_t RedisReader::readDirect(uint8_t *dst, size_t len)
+{
+    if (buffered() || _client.available() <= 0)
+        return 0;
+
+    auto got = _client.read(dst, len);
+    if (got <= 0)
+        return 0;
+
+    _consumed += got;
+    return got;
+}
+
+bool RedisReader::fill(size_t want)
+{
+    if (_head == _tail)
+    {
+        _head = _tail = 0;
+    }
+    else if (_tail == sizeof(_buf))
+    {
+        memmove(_buf, _buf + _head, _tail - _head);
+        _tail -= _head;
+        _head = 0;
+    }
+
+    auto space = sizeof(_buf) - _tail;
+    if (!space || _client.available() <= 0)
+        return false;
+
+    auto toRead = _readAhead || want > space ? space : want;
+    auto got = _client.read(_buf + _tail, toRead);
+    if (got <= 0)
+        return false;
+
+    _tail += got;
+    return true;
 }
 
 String RedisSimpleString::RESP()
@@ -20,53 +205,112 @@ String RedisSimpleString::RESP()
     return emitStr;
 }
 
-void RedisBulkString::init(Client &client)
+RedisInteger::RedisInteger(const String &s) : RedisSimpleString(String()), _value(0)
 {
-    auto dLen = data.toInt();
+    _type = Type::Integer;
+    parse(s.c_str(), s.length(), _value);
+}
 
-    // "Null Bulk String" -- https://redis.io/topics/protocol#resp-bulk-strings
-    if (dLen == -1)
+bool RedisInteger::parse(const char *str, size_t len, int64_t &value)
+{
+    auto negative = len && str[0] == '-';
+    size_t i = len && (str[0] == '-' || str[0] == '+') ? 1 : 0;
+    if (i == len)
     {
-        data = (const char *)nullptr;
-        return;
+        return false;
     }
 
-    auto charBuf = new char[dLen + 1];
-    bzero(charBuf, dLen + 1);
+    // accumulated as a magnitude, so that INT64_MIN (whose magnitude exceeds INT64_MAX) can be read
+    const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t magnitude = 0;
+    for (; i < len; i++)
+    {
+        auto digit = (uint8_t)(str[i] - '0');
+        if (digit > 9 || magnitude > (limit - digit) / 10)
+        {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
 
-    auto readB = client.readBytes(charBuf, dLen);
-    if ((int)readB != dLen)
+    value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return true;
+}
+
+bool RedisDouble::parse(const char *str, size_t len, double &value)
+{
+    // strtod() would also skip leading space, and read hexadecimal
+    if (!len || isspace((unsigned char)str[0]) || memchr(str, 'x', len) || memchr(str, 'X', len))
     {
-        Serial.printf("ERROR! Bad read (%ld ?= %ld)\n", (long)readB, (long)dLen);
-        exit(-1);
+        return false;
     }
 
-    data = String(charBuf);
-    delete[] charBuf;
+    char *end = nullptr;
+    value = strtod(str, &end);
+    return end == str + len;
 }
 
-String RedisBulkString::RESP()
+RedisInteger::operator String()
+{
+    char digits[24];
+    auto end = digits + sizeof(digits) - 1;
+    *end = '\0';
+    return String(formatDecimal(end, _value < 0 ? 0ULL - (unsigned long long)_value : (unsigned long long)_value, _value < 0));
+}
+
+String RedisInteger::RESP()
 {
     String emitStr((char)_type);
-    emitStr += String(data.length());
-    emitStr += CRLF;
-    emitStr += data;
+    emitStr += operator String();
     emitStr += CRLF;
     return emitStr;
 }
 
-void RedisArray::init(Client &client)
+RedisBulkString::RedisBulkString(const uint8_t *buf, size_t len) : RedisObject(Type::BulkString)
 {
-    // Null array https://redis.io/docs/reference/protocol-spec/#null-arrays
-    if (data.toInt() == -1)
-    {
-        return;
-    }
+    allocate(len);
+    memcpy(_buf, buf, len);
+}
+
+RedisBulkString::~RedisBulkString()
+{
+    if (_owned)
+        delete[] _buf;
+}
+
+void RedisBulkString::allocate(size_t len)
+{
+    _buf = new uint8_t[len + 1];
+    _buf[len] = '\0';
+    _len = len;
+}
 
-    for (int i = 0; i < data.toInt(); i++)
+RedisBulkString::operator String()
+{
+    if (!_buf)
+        return String("(nil)");
+
+    String str("");
+    if (str.reserve(_len))
+        str.concat((const char *)_buf, _len);
+    return str;
+}
+
+String RedisBulkString::RESP()
+{
+    String emitStr((char)_type);
+    if (!_buf)
     {
-        add(RedisObject::parseType(client));
+        emitStr += "-1";
+        emitStr += CRLF;
+        return emitStr;
     }
+
+    emitStr += String((unsigned long)_len);
+    emitStr += CRLF;
+    emitStr.concat((const char *)_buf, _len);
+    emitStr += CRLF;
+    return emitStr;
 }
 
 RedisArray::operator std::vector<std::shared_ptr<RedisObject>>() const
@@ -94,6 +338,26 @@ RedisArray::operator std::vector<String>() const
     return rv;
 }
 
+std::shared_ptr<RedisObject> RedisArray::lookup(const char *key) const
+{
+    auto len = strlen(key);
+    for (size_t i = 0; i + 1 < vec.size(); i += 2)
+    {
+        auto k = vec[i].get();
+        if (k->type() == RedisObject::Type::BulkString)
+        {
+            auto bulk = (RedisBulkString *)k;
+            if (bulk->length() == len && !memcmp(bulk->bytes(), key, len))
+                return vec[i + 1];
+        }
+        else if (k->type() == RedisObject::Type::SimpleString && (String)*k == key)
+        {
+            return vec[i + 1];
+        }
+    }
+    return nullptr;
+}
+
 String RedisArray::RESP()
 {
     String emitStr((char)_type);
@@ -108,21 +372,130 @@ String RedisArray::RESP()
 
 std::shared_ptr<RedisObject> RedisCommand::issue(Client &cmdClient)
 {
-    if (!cmdClient.connected())
-        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+    RedisReader reader(cmdClient, false);
+    return issue(reader);
+}
+
+// Send a command with `send`, then read its reply. Should the connection be found lost, the reader's disconnect
+// handler may restore it and have the command issued once more: only if nothing of its reply was read, and
+// there is no sink or visitor that would see elements twice.
+template <typename Send>
+static std::shared_ptr<RedisObject> issueRetrying(RedisReader &reader, const char *name, size_t nameLen, Send send)
+{
+    reader.settle();
+    auto retry = reader.disconnectHandler() && !reader.parser().hooked();
+    while (true)
+    {
+        auto consumedBefore = reader.consumed();
+        std::shared_ptr<RedisObject> ret;
+        if (reader.client().connected())
+        {
+            send();
+            ret = RedisObject::parseType(reader);
+        }
+        else
+        {
+            ret = std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+        }
+
+        if (!retry || ret->type() != RedisObject::Type::InternalError ||
+            ((RedisInternalError *)ret.get())->code() != RedisInternalError::Disconnected ||
+            reader.consumed() != consumedBefore || !reader.reconnect(name, nameLen))
+        {
+            return ret;
+        }
+        retry = false;
+    }
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(RedisReader &reader)
+{
+    // RedisCommand only ever holds the bulk strings added by its constructors
+    auto name = (RedisBulkString *)vec[0].get();
+    auto ret = issueRetrying(reader, (const char *)name->bytes(), name->length(), [&]()
+                             {
+        RedisEncoder enc(reader.client());
+        enc.array(vec.size());
+        for (auto &arg : vec)
+        {
+            auto argStr = (RedisBulkString *)arg.get();
+            enc.bulk((const char *)argStr->bytes(), argStr->length());
+        } });
 
-    auto cmdRespStr = RESP();
-    cmdClient.print(cmdRespStr);
-    auto ret = RedisObject::parseType(cmdClient);
     if (ret && ret->type() == RedisObject::Type::InternalError)
         _err = (String)*ret;
     return ret;
 }
 
+std::shared_ptr<RedisObject> RedisCommand::issue(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs)
+{
+    RedisReader reader(cmdClient, false);
+    return issue(reader, cmdAndArgs);
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs)
+{
+    auto &name = *cmdAndArgs.begin();
+    return issueRetrying(reader, name.data(), name.length(), [&]()
+                         { RedisEncoder(reader.client()).command(cmdAndArgs); });
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(Client &cmdClient, const String &command, const ArgList &args)
+{
+    RedisReader reader(cmdClient, false);
+    return issue(reader, command, args);
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(RedisReader &reader, const String &command, const ArgList &args)
+{
+    return issueRetrying(reader, command.c_str(), command.length(), [&]()
+                         { RedisEncoder(reader.client()).command(command, args); });
+}
+
+// Parse the reply to a command just sent by handing its elements to `visitor`
+static std::shared_ptr<RedisObject> visitReply(RedisReader &reader, RedisVisitor &visitor)
+{
+    reader.parser().setVisitor(&visitor);
+    auto ret = RedisObject::parseType(reader);
+    reader.parser().setVisitor(nullptr);
+    return ret;
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs, RedisVisitor &visitor)
+{
+    RedisReader reader(cmdClient, false);
+    return issue(reader, cmdAndArgs, visitor);
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs, RedisVisitor &visitor)
+{
+    reader.settle();
+    if (!reader.client().connected())
+        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+
+    RedisEncoder(reader.client()).command(cmdAndArgs);
+    return visitReply(reader, visitor);
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(Client &cmdClient, const String &command, const ArgList &args, RedisVisitor &visitor)
+{
+    RedisReader reader(cmdClient, false);
+    return issue(reader, command, args, visitor);
+}
+
+std::shared_ptr<RedisObject> RedisCommand::issue(RedisReader &reader, const String &command, const ArgList &args, RedisVisitor &visitor)
+{
+    reader.settle();
+    if (!reader.client().connected())
+        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+
+    RedisEncoder(reader.client()).command(command, args);
+    return visitReply(reader, visitor);
+}
+
 template <>
-int RedisCommand::issue_typed<int>(Client &cmdClient)
+int RedisCommand::convert_typed<int>(std::shared_ptr<RedisObject> cmdRet)
 {
-    auto cmdRet = issue(cmdClient);
     if (!cmdRet)
         return INT_MAX - 0x0f;
     if (cmdRet->type() != RedisObject::Type::Integer)
@@ -131,74 +504,786 @@ int RedisCommand::issue_typed<int>(Client &cmdClient)
 }
 
 template <>
-bool RedisCommand::issue_typed<bool>(Client &cmdClient)
+bool RedisCommand::convert_typed<bool>(std::shared_ptr<RedisObject> cmdRet)
 {
-    auto cmdRet = issue(cmdClient);
     if (cmdRet && cmdRet->type() == RedisObject::Type::Integer)
         return (bool)*((RedisInteger *)cmdRet.get());
     return false;
 }
 
 template <>
-String RedisCommand::issue_typed<String>(Client &cmdClient)
+String RedisCommand::convert_typed<String>(std::shared_ptr<RedisObject> cmdRet)
 {
-    return (String)*issue(cmdClient);
+    if (!cmdRet)
+        return String("(nil)");
+    return (String)*cmdRet;
 }
 
-typedef std::map<RedisObject::Type, std::function<RedisObject *(Client &)>> TypeParseMap;
+template <>
+int64_t RedisCommand::convert_typed<int64_t>(std::shared_ptr<RedisObject> cmdRet)
+{
+    return convert_result<int64_t>(cmdRet).value;
+}
 
-static TypeParseMap g_TypeParseMap{
-    {RedisObject::Type::SimpleString, [](Client &c)
-     { return new RedisSimpleString(c); }},
-    {RedisObject::Type::BulkString, [](Client &c)
-     { return new RedisBulkString(c); }},
-    {RedisObject::Type::Integer, [](Client &c)
-     { return new RedisInteger(c); }},
-    {RedisObject::Type::Array, [](Client &c)
-     { return new RedisArray(c); }},
-    {RedisObject::Type::Error, [](Client &c)
-     { return new RedisError(c); }}};
+template <>
+double RedisCommand::convert_typed<double>(std::shared_ptr<RedisObject> cmdRet)
+{
+    auto result = convert_result<double>(cmdRet);
+    return result.ok() ? result.value : NAN;
+}
 
-std::shared_ptr<RedisObject> RedisObject::parseTypeNonBlocking(Client &client)
+// Settles the status of a result that can have no value: an error, a nil, or a missing reply.
+// @return `true` if `reply` has a value to convert
+template <typename T>
+static bool convertible(const std::shared_ptr<RedisObject> &reply, RedisResult<T> &result)
 {
-    if (client.connected() && !client.available())
+    if (!reply)
+    {
+        result.status = RedisResultInternalError;
+        return false;
+    }
+
+    switch (reply->type())
+    {
+    case RedisObject::Type::Error:
+        result.status = RedisResultError;
+        result.error = reply;
+        return false;
+    case RedisObject::Type::InternalError:
+        result.status = RedisResultInternalError;
+        result.error = reply;
+        return false;
+    case RedisObject::Type::BulkString:
+        if (((RedisBulkString *)reply.get())->isNilReturn())
+        {
+            result.status = RedisResultNil;
+            return false;
+        }
+        return true;
+    case RedisObject::Type::Array:
+        if (((RedisArray *)reply.get())->isNilReturn())
+        {
+            result.status = RedisResultNil;
+            return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+// The text of a string reply, in place: a bulk string's bytes, or a simple string's (as which a RESP3
+// double or big number is represented)
+static const char *textOf(const std::shared_ptr<RedisObject> &reply, size_t &len)
+{
+    if (reply->type() == RedisObject::Type::BulkString)
+    {
+        auto bulk = (RedisBulkString *)reply.get();
+        len = bulk->length();
+        return (const char *)bulk->bytes();
+    }
+
+    if (reply->type() == RedisObject::Type::SimpleString)
+    {
+        auto text = ((RedisSimpleString *)reply.get())->c_str();
+        len = strlen(text);
+        return text;
+    }
+    return nullptr;
+}
+
+template <>
+RedisResult<int64_t> RedisCommand::convert_result<int64_t>(std::shared_ptr<RedisObject> reply)
+{
+    RedisResult<int64_t> result;
+    if (!convertible(reply, result))
+    {
+        return result;
+    }
+
+    if (reply->type() == RedisObject::Type::Integer)
+    {
+        result.value = ((RedisInteger *)reply.get())->value();
+        return result;
+    }
+
+    size_t len = 0;
+    auto text = textOf(reply, len);
+    if (!text || !RedisInteger::parse(text, len, result.value))
+    {
+        result.status = RedisResultWrongType;
+    }
+    return result;
+}
+
+template <>
+RedisResult<int> RedisCommand::convert_result<int>(std::shared_ptr<RedisObject> reply)
+{
+    auto wide = convert_result<int64_t>(reply);
+    RedisResult<int> result;
+    result.status = wide.status;
+    result.error = wide.error;
+    if (wide.ok())
+    {
+        if (wide.value < INT_MIN || wide.value > INT_MAX)
+        {
+            result.status = RedisResultOutOfRange;
+        }
+        else
+        {
+            result.value = (int)wide.value;
+        }
+    }
+    return result;
+}
+
+template <>
+RedisResult<double> RedisCommand::convert_result<double>(std::shared_ptr<RedisObject> reply)
+{
+    RedisResult<double> result;
+    if (!convertible(reply, result))
+    {
+        return result;
+    }
+
+    if (reply->type() == RedisObject::Type::Integer)
+    {
+        result.value = (double)((RedisInteger *)reply.get())->value();
+        return result;
+    }
+
+    if (reply->wireType() == RedisObject::Type::Double)
+    {
+        result.value = ((RedisDouble *)reply.get())->value();
+        return result;
+    }
+
+    // copied out to be NUL-terminated, as a bulk string read into a caller's buffer is not; no double that Redis
+    // formats is longer
+    size_t len = 0;
+    auto text = textOf(reply, len);
+    char number[64];
+    if (!text || !len || len >= sizeof(number))
+    {
+        result.status = RedisResultWrongType;
+        return result;
+    }
+
+    memcpy(number, text, len);
+    number[len] = '\0';
+    char *end = nullptr;
+    result.value = strtod(number, &end);
+    if (end != number + len)
+    {
+        result.value = 0;
+        result.status = RedisResultWrongType;
+    }
+    return result;
+}
+
+template <>
+RedisResult<bool> RedisCommand::convert_result<bool>(std::shared_ptr<RedisObject> reply)
+{
+    RedisResult<bool> result;
+    if (!convertible(reply, result))
+    {
+        return result;
+    }
+
+    // an integer, or a RESP3 boolean (represented as one)
+    if (reply->type() == RedisObject::Type::Integer)
+    {
+        result.value = ((RedisInteger *)reply.get())->value() != 0;
+    }
+    else
+    {
+        result.status = RedisResultWrongType;
+    }
+    return result;
+}
+
+template <>
+RedisResult<String> RedisCommand::convert_result<String>(std::shared_ptr<RedisObject> reply)
+{
+    RedisResult<String> result;
+    if (!convertible(reply, result))
+    {
+        return result;
+    }
+
+    if (reply->type() == RedisObject::Type::Array)
+    {
+        result.status = RedisResultWrongType;
+    }
+    else
+    {
+        result.value = (String)*reply;
+    }
+    return result;
+}
+
+// How the parser reads the remainder of each reply type once its header line has been read
+enum class Framing : uint8_t
+{
+    Unknown,
+    Line,      // the header line is the whole value
+    Bulk,      // the header is a byte count, followed by that many bytes and CRLF
+    Aggregate, // the header is an element count, followed by that many replies
+    Pairs      // the header is a pair count, followed by twice that many replies
+};
+
+// Dispatch on the type byte is a switch rather than a lookup structure so that it compiles
+// to a jump table: no static initialization, no RAM, and no indirect call per node.
+// RESP3 types are framed here so a RESP3 reply parses correctly; until they have types of their
+// own, each is represented by the nearest RESP2 type.
+static Framing framing(char type)
+{
+    switch (type)
+    {
+    case '+': // simple string
+    case '-': // simple error
+    case ':': // integer
+    case '_': // RESP3 null
+    case '#': // RESP3 boolean
+    case ',': // RESP3 double
+    case '(': // RESP3 big number
+        return Framing::Line;
+    case '$': // bulk string
+    case '=': // RESP3 verbatim string
+    case '!': // RESP3 blob error
+        return Framing::Bulk;
+    case '*': // array
+    case '~': // RESP3 set
+    case '>': // RESP3 push
+        return Framing::Aggregate;
+    case '%': // RESP3 map
+        return Framing::Pairs;
+    default:
+        return Framing::Unknown;
+    }
+}
+
+// Elements reserved up front for an aggregate, however many its header claims, so that a
+// corrupt or hostile count cannot exhaust the heap before any element has arrived
+#define REDIS_AGGREGATE_RESERVE_MAX 256
+
+RedisArena::~RedisArena()
+{
+    while (_head)
+    {
+        auto next = _head->next;
+        free(_head);
+        _head = next;
+    }
+}
+
+// `size` bytes at the first multiple of `align` at or after `used` bytes into `block`'s payload, if there is room
+static void *place(uintptr_t base, size_t &used, size_t cap, size_t size, size_t align)
+{
+    auto offset = (base + used + align - 1) / align * align - base;
+    if (offset + size > cap)
     {
         return nullptr;
     }
+    used = offset + size;
+    return (void *)(base + offset);
+}
 
-    RedisObject::Type typeChar = RedisObject::Type::NoType;
-    if (!client.connected())
+void *RedisArena::allocate(size_t size, size_t align)
+{
+    if (_head)
     {
-        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+        auto at = place((uintptr_t)(_head + 1), _head->used, _head->cap, size, align);
+        if (at)
+        {
+            return at;
+        }
     }
 
-    typeChar = (RedisObject::Type)client.read();
-    if (typeChar == -1 || typeChar == '\r' || typeChar == '\n')
+    // the payload follows a header padded to malloc()'s alignment, so is as aligned as malloc()'s result;
+    // anything aligned more strictly gets the slack to be placed further in
+    auto slack = align > alignof(Block) ? align - 1 : 0;
+    auto cap = size + slack > REDIS_ARENA_BLOCK_SIZE ? size + slack : REDIS_ARENA_BLOCK_SIZE;
+    auto block = (Block *)malloc(sizeof(Block) + cap);
+    if (!block)
     {
         return nullptr;
-    };
+    }
+
+    block->cap = cap;
+    block->used = 0;
+    auto at = place((uintptr_t)(block + 1), block->used, cap, size, align);
+    if (_head && size + slack > REDIS_ARENA_BLOCK_SIZE)
+    {
+        // keep filling the current block; an oversized block is only ever used once
+        block->next = _head->next;
+        _head->next = block;
+    }
+    else
+    {
+        block->next = _head;
+        _head = block;
+    }
+    return at;
+}
 
-    if (g_TypeParseMap.find(typeChar) != g_TypeParseMap.end())
+template <typename T, typename... Args>
+std::shared_ptr<RedisObject> RedisParser::create(Args &&...args)
+{
+    if (_arena)
     {
-        auto retVal = g_TypeParseMap[typeChar](client);
+        return std::allocate_shared<T>(RedisArenaAllocator<T>(_arena), std::forward<Args>(args)...);
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
 
-        if (!retVal)
+// Constructs the object for `type` from the header line that follows the type byte.
+// Bulk strings (as nil) and aggregates are created empty here; feed() then reads their contents.
+std::shared_ptr<RedisObject> RedisParser::createNode(char type, const String &line)
+{
+    switch (type)
+    {
+    case '+':
+    case '(':
+        return create<RedisSimpleString>(line);
+    case '-':
+        return create<RedisError>(line);
+    case ':':
+    {
+        // rather than read as 0, as String::toInt() would have, and taken for a real value
+        int64_t value = 0;
+        if (!RedisInteger::parse(line.c_str(), line.length(), value))
         {
-            return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownError, "(nil)"));
+            return create<RedisInternalError>(RedisInternalError::MalformedReply, "integer " + line);
         }
+        return create<RedisInteger>(value);
+    }
+    case ',':
+    {
+        double value = 0;
+        if (!RedisDouble::parse(line.c_str(), line.length(), value))
+        {
+            return create<RedisInternalError>(RedisInternalError::MalformedReply, "double " + line);
+        }
+        return create<RedisDouble>(line, value);
+    }
+    case '#':
+        return create<RedisInteger>((int64_t)(line == "t"));
+    case '$':
+    case '=':
+    case '!':
+    case '_':
+        return create<RedisBulkString>();
+    case '*':
+    case '~':
+    case '>':
+    case '%':
+        return create<RedisArray>();
+    default:
+        return nullptr;
+    }
+}
 
-        return std::shared_ptr<RedisObject>(retVal);
+void RedisParser::reset()
+{
+    _state = ReadType;
+    _line = String();
+    _bulk = nullptr;
+    _bulkRemaining = 0;
+    _stack.clear();
+    _target = nullptr;
+    _arena = nullptr;
+    _sink = nullptr;
+    _visitor = nullptr;
+    _inPush = false;
+}
+
+void RedisParser::finish()
+{
+    _arena = nullptr;
+    if (_inPush)
+    {
+        setHooks(_pushed);
+        _inPush = false;
+        return;
     }
 
-    return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownType, String(typeChar)));
+    _target = nullptr;
+    _sink = nullptr;
+    _visitor = nullptr;
 }
 
-std::shared_ptr<RedisObject> RedisObject::parseType(Client &client)
+RedisParser::Hooks RedisParser::takeHooks()
+{
+    auto hooks = Hooks{_target, _targetCap, _sinkDepth, _sink, _sinkContext, _visitor};
+    _target = nullptr;
+    _sink = nullptr;
+    _visitor = nullptr;
+    return hooks;
+}
+
+void RedisParser::setHooks(const Hooks &hooks)
+{
+    _target = hooks.target;
+    _targetCap = hooks.targetCap;
+    _sinkDepth = hooks.sinkDepth;
+    _sink = hooks.sink;
+    _sinkContext = hooks.sinkContext;
+    _visitor = hooks.visitor;
+}
+
+size_t RedisParser::wanted() const
+{
+    switch (_state)
+    {
+    case ReadBulk:
+        return _bulkRemaining + 2;
+    case ReadBulkEnd:
+        return _bulkRemaining;
+    default:
+        return 1;
+    }
+}
+
+std::shared_ptr<RedisObject> RedisParser::header()
+{
+    auto frame = framing(_type);
+    auto count = _line.toInt();
+
+    // a push frame may arrive ahead of the reply the hooks were set for, so is parsed without them
+    if (_type == '>' && !_stack.size())
+    {
+        _pushed = takeHooks();
+        _inPush = true;
+    }
+
+    // only an aggregate has enough nodes to be worth an arena; and an arena would keep every
+    // element handed to a sink alive until the whole reply is done with
+    if (_useArena && !_sink && !_visitor && !_stack.size() && (frame == Framing::Aggregate || frame == Framing::Pairs) && count > 0)
+    {
+        _arena = std::make_shared<RedisArena>();
+    }
+
+    auto node = createNode(_type, _line);
+    if (!node)
+    {
+        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownError, "(nil)"));
+    }
+
+    // a RESP3 node keeps its own type alongside the RESP2 type of its class
+    if (_type != '!' && _type != (char)node->type() && node->type() != RedisObject::Type::InternalError)
+    {
+        node->_wire = _type;
+    }
+
+    if (frame == Framing::Bulk && count >= 0)
+    {
+        _bulk = std::static_pointer_cast<RedisBulkString>(node);
+        if (_target && !_stack.size() && (size_t)count <= _targetCap)
+        {
+            _bulk->_buf = _target;
+            _bulk->_len = count;
+            _bulk->_owned = false;
+        }
+        else if (_arena && (_bulk->_buf = (uint8_t *)_arena->allocate(count + 1, 1)))
+        {
+            _bulk->_buf[count] = '\0';
+            _bulk->_len = count;
+            _bulk->_owned = false;
+        }
+        else
+        {
+            _bulk->allocate(count);
+        }
+
+        if (count)
+        {
+            _bulkRemaining = count;
+            _state = ReadBulk;
+        }
+        else
+        {
+            _bulkRemaining = 2;
+            _state = ReadBulkEnd;
+        }
+        return nullptr;
+    }
+
+    if (frame == Framing::Aggregate || frame == Framing::Pairs)
+    {
+        node->data = _line;
+        if (frame == Framing::Pairs && count > 0)
+        {
+            count *= 2;
+        }
+
+        if (_visitor)
+        {
+            _visitor->aggregate(node->type(), count < 0 ? -1 : count, _stack.size());
+        }
+
+        if (count > 0)
+        {
+            // (elements bound for a sink or visitor never occupy the array)
+            if (!_visitor && (!_sink || _stack.size() + 1 != _sinkDepth))
+            {
+                ((RedisArray *)node.get())->vec.reserve(count < REDIS_AGGREGATE_RESERVE_MAX ? count : REDIS_AGGREGATE_RESERVE_MAX);
+            }
+            _stack.push_back(Frame{std::static_pointer_cast<RedisArray>(node), count});
+            _state = ReadType;
+            return nullptr;
+        }
+    }
+
+    return node;
+}
+
+void RedisParser::visit(const std::shared_ptr<RedisObject> &node)
 {
-    std::shared_ptr<RedisObject> type = nullptr;
-    while (type == nullptr)
+    if (node->type() == RedisObject::Type::BulkString)
+    {
+        auto bulk = (RedisBulkString *)node.get();
+        _visitor->element(node->type(), bulk->bytes(), bulk->length(), _stack.size());
+    }
+    else if (node->type() == RedisObject::Type::Integer)
+    {
+        auto value = ((RedisInteger *)node.get())->value();
+        char digits[24];
+        auto end = digits + sizeof(digits) - 1;
+        *end = '\0';
+        auto start = formatDecimal(end, value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value, value < 0);
+        _visitor->element(node->type(), (const uint8_t *)start, end - start, _stack.size());
+    }
+    else
+    {
+        _visitor->element(node->type(), (const uint8_t *)node->data.c_str(), node->data.length(), _stack.size());
+    }
+}
+
+std::shared_ptr<RedisObject> RedisParser::complete(std::shared_ptr<RedisObject> node)
+{
+    _state = ReadType;
+
+    // aggregates were announced to the visitor by header()
+    if (_visitor && node->type() != RedisObject::Type::Array)
     {
-        type = parseTypeNonBlocking(client);
+        visit(node);
     }
-    return type;
+
+    while (_stack.size())
+    {
+        auto &top = _stack.back();
+        if (_visitor)
+        {
+            // never retained: the visitor has already seen it
+        }
+        else if (_sink && _stack.size() == _sinkDepth)
+        {
+            _sink(node, _sinkContext);
+        }
+        else
+        {
+            top.array->add(node);
+        }
+
+        if (--top.remaining > 0)
+        {
+            return nullptr;
+        }
+
+        node = top.array;
+        _stack.pop_back();
+    }
+    return node;
+}
+
+std::shared_ptr<RedisObject> RedisParser::feed(RedisReader &reader)
+{
+    while (true)
+    {
+        // large payloads bypass the reader's buffer entirely
+        if (_state == ReadBulk && !reader.buffered() && (size_t)_bulkRemaining >= REDIS_READER_BUFFER_SIZE)
+        {
+            auto got = reader.readDirect(_bulk->_buf + _bulk->_len - _bulkRemaining, _bulkRemaining);
+            _bulkRemaining -= got;
+            if (!_bulkRemaining)
+            {
+                _state = ReadBulkEnd;
+                _bulkRemaining = 2;
+            }
+
+            if (got)
+            {
+                continue;
+            }
+        }
+
+        if (!reader.poll(wanted()))
+        {
+            break;
+        }
+
+        auto buf = reader.peek();
+        auto avail = reader.buffered();
+        std::shared_ptr<RedisObject> node = nullptr;
+
+        switch (_state)
+        {
+        case ReadType:
+            _type = (char)*buf;
+            reader.consume(1);
+
+            // tolerate stray line terminators between replies
+            if (_type == '\r' || _type == '\n')
+            {
+                continue;
+            }
+
+            if (framing(_type) == Framing::Unknown)
+            {
+                auto type = _type;
+                reset();
+                return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownType, String((char)type)));
+            }
+
+            // assigned rather than replaced, so that the line keeps its buffer from one reply to the next
+            _line = "";
+            _state = ReadLine;
+            continue;
+
+        case ReadLine:
+        {
+            auto cr = (const uint8_t *)memchr(buf, '\r', avail);
+            auto len = cr ? (size_t)(cr - buf) : avail;
+            if (len)
+            {
+                _line.concat((const char *)buf, len);
+            }
+            reader.consume(cr ? len + 1 : len);
+            if (cr)
+            {
+                _state = ReadLineEnd;
+            }
+            continue;
+        }
+
+        case ReadLineEnd:
+            reader.consume(1); // the LF
+            node = header();
+            if (!node)
+            {
+                continue;
+            }
+            break;
+
+        case ReadBulk:
+        {
+            auto len = avail < (size_t)_bulkRemaining ? avail : (size_t)_bulkRemaining;
+            memcpy(_bulk->_buf + _bulk->_len - _bulkRemaining, buf, len);
+            reader.consume(len);
+            _bulkRemaining -= len;
+            if (!_bulkRemaining)
+            {
+                _state = ReadBulkEnd;
+                _bulkRemaining = 2;
+            }
+            continue;
+        }
+
+        case ReadBulkEnd:
+        {
+            // the CRLF following the payload
+            auto len = avail < (size_t)_bulkRemaining ? avail : (size_t)_bulkRemaining;
+            reader.consume(len);
+            _bulkRemaining -= len;
+            if (_bulkRemaining)
+            {
+                continue;
+            }
+            node = _bulk;
+            if (_type == '!')
+            {
+                // a RESP3 blob error is framed as a bulk string but is an error all the same
+                node = create<RedisError>((String)*_bulk);
+            }
+            else if (_type == '=' && _bulk->_len >= 4 && _bulk->_buf[3] == ':')
+            {
+                // a verbatim string's payload is prefixed by its format, e.g. "txt:"
+                memmove(_bulk->_buf, _bulk->_buf + 4, _bulk->_len - 4);
+                _bulk->_len -= 4;
+                _bulk->_buf[_bulk->_len] = '\0';
+            }
+            _bulk = nullptr;
+            break;
+        }
+        }
+
+        auto reply = complete(node);
+        if (reply)
+        {
+            finish();
+            return reply;
+        }
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<RedisObject> RedisObject::parseTypeNonBlocking(RedisReader &reader)
+{
+    auto ret = reader.parser().feed(reader);
+    while (ret && ret->wireType() == Type::Push && reader.pushHandler())
+    {
+        reader.pushHandler()(ret, reader.pushContext());
+        ret = reader.parser().feed(reader);
+    }
+
+    if (!ret && !reader.connected())
+    {
+        reader.parser().reset();
+        return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+    }
+    return ret;
+}
+
+std::shared_ptr<RedisObject> RedisObject::parseType(RedisReader &reader)
+{
+    auto lastProgress = millis();
+    while (true)
+    {
+        auto consumedBefore = reader.consumed();
+        auto ret = parseTypeNonBlocking(reader);
+        if (ret)
+        {
+            return ret;
+        }
+
+        if (reader.consumed() != consumedBefore)
+        {
+            lastProgress = millis();
+        }
+        else if (reader.parser().inProgress() && millis() - lastProgress >= reader.client().getTimeout())
+        {
+            reader.parser().reset();
+            return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownError, "reply timed out"));
+        }
+
+        yield();
+    }
+}
+
+std::shared_ptr<RedisObject> RedisObject::parseTypeNonBlocking(Client &client)
+{
+    if (client.connected() && !client.available())
+    {
+        return nullptr;
+    }
+
+    return parseType(client);
+}
+
+std::shared_ptr<RedisObject> RedisObject::parseType(Client &client)
+{
+    RedisReader reader(client, false);
+    return parseType(reader);
 }
@@ -5,12 +5,132 @@
 #include "Client.h"
 #include <vector>
 #include <memory>
+#include <cstddef>
 #include <functional>
+#include <initializer_list>
+
+#include "RedisResult.h"
 
 #define CRLF F("\r\n")
 
+/** Size of the on-stack staging buffer RedisEncoder uses to coalesce small writes to a Print */
+#ifndef REDIS_ENCODER_CHUNK_SIZE
+#define REDIS_ENCODER_CHUNK_SIZE 128
+#endif
+
+/** Size of the read-ahead buffer each Redis connection keeps between its Client and the RESP parser */
+#ifndef REDIS_READER_BUFFER_SIZE
+#define REDIS_READER_BUFFER_SIZE 256
+#endif
+
+/** Size of each block a RedisArena takes from the heap; larger allocations get a block of their own */
+#ifndef REDIS_ARENA_BLOCK_SIZE
+#define REDIS_ARENA_BLOCK_SIZE 1024
+#endif
+
+/** Whether replies are parsed into a RedisArena by default (see RedisParser::setArena()) */
+#ifndef REDIS_USE_ARENA
+#define REDIS_USE_ARENA 0
+#endif
+
 typedef std::vector<String> ArgList;
 
+class RedisReader;
+
+/** A non-owning view of a single command argument, consumed by RedisEncoder.
+ *  Integers are formatted into inline storage, so no argument ever touches the heap.
+ *  The viewed string must outlive the encoding call, which temporaries in an
+ *  argument list always do.
+ */
+class RedisArg
+{
+public:
+    RedisArg(const char *s) : _ptr(s ? s : ""), _len(s ? strlen(s) : 0) {}
+    RedisArg(const String &s) : _ptr(s.c_str()), _len(s.length()) {}
+    RedisArg(const uint8_t *buf, size_t len) : _ptr((const char *)buf), _len(len) {}
+    RedisArg(long v);
+    RedisArg(int v) : RedisArg((long)v) {}
+    RedisArg(unsigned long v);
+    RedisArg(unsigned int v) : RedisArg((unsigned long)v) {}
+    RedisArg(long long v);
+    RedisArg(unsigned long long v);
+
+    const char *data() const { return _ptr ? _ptr : _num; }
+    size_t length() const { return _len; }
+
+private:
+    const char *_ptr = nullptr;
+    size_t _len = 0;
+    char _num[24];
+};
+
+/** Streams the RESP encoding of commands straight to a Print (usually the Client) or into
+ *  a fixed-size caller-supplied buffer, without building any intermediate String or object.
+ *
+ *  When writing to a Print, output is staged through a REDIS_ENCODER_CHUNK_SIZE buffer on
+ *  the stack so that a short command costs a single write(); arguments too large for the
+ *  staging buffer are written through directly.
+ */
+class RedisEncoder
+{
+public:
+    RedisEncoder(Print &out) : _out(&out), _buf(_chunk), _cap(sizeof(_chunk)) {}
+    RedisEncoder(uint8_t *buf, size_t cap) : _buf(buf), _cap(cap) {}
+    ~RedisEncoder() { flush(); }
+
+    RedisEncoder(const RedisEncoder &) = delete;
+    RedisEncoder &operator=(const RedisEncoder &) = delete;
+
+    /** Encode a command given as its name followed by its arguments */
+    RedisEncoder &command(std::initializer_list<RedisArg> cmdAndArgs);
+    RedisEncoder &command(const String &cmd, const ArgList &args);
+
+    /** Low-level building blocks: an array header followed by that many bulk strings */
+    RedisEncoder &array(size_t count);
+    RedisEncoder &bulk(const char *buf, size_t len);
+    RedisEncoder &bulk(const RedisArg &arg) { return bulk(arg.data(), arg.length()); }
+
+    /** Write any staged output to the underlying Print. Called automatically on destruction. */
+    void flush();
+
+    /** @return `true` if a fixed buffer was too small (or the Print short-wrote); output is then incomplete. */
+    bool overflowed() const { return _overflow; }
+
+    /** @return The total number of bytes encoded so far (for a fixed buffer, the number of valid bytes in it). */
+    size_t size() const { return _total; }
+
+private:
+    void put(const char *buf, size_t len);
+    void header(char type, long len);
+
+    Print *_out = nullptr;
+    uint8_t *_buf;
+    size_t _cap;
+    size_t _used = 0;
+    size_t _total = 0;
+    bool _overflow = false;
+    uint8_t _chunk[REDIS_ENCODER_CHUNK_SIZE];
+};
+
+/** Accumulates encoded commands (e.g. those of a pipeline or transaction) to be written to the Client in one call */
+class RedisOutbound : public Print
+{
+public:
+    size_t write(uint8_t b) override
+    {
+        bytes.push_back(b);
+        return 1;
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        bytes.insert(bytes.end(), buf, buf + size);
+        return size;
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
 /** A basic object model for the Redis serialization protocol (RESP):
  *      https://redis.io/topics/protocol
  */
@@ -31,24 +151,48 @@ public:
         Integer = ':',
         BulkString = '$',
         Array = '*',
-        InternalError = '!'
+        InternalError = '!',
+
+        /* RESP3 types (https://github.com/redis/redis-specifications/blob/master/protocol/RESP3.md), as
+         * returned by `wireType()`. Each is represented by the class of its nearest RESP2 type, which
+         * `type()` returns: Null, VerbatimString -> BulkString; Boolean -> Integer (1 or 0); Double,
+         * BigNumber -> SimpleString (as text; a Double's value is also parsed, see RedisDouble);
+         * Map, Set, Push -> Array (a map's keys and values alternating).
+         * A RESP3 blob error, sharing its type byte with InternalError, is simply an Error. */
+        Null = '_',
+        Boolean = '#',
+        Double = ',',
+        BigNumber = '(',
+        VerbatimString = '=',
+        Map = '%',
+        Set = '~',
+        Push = '>'
     } Type;
 
     RedisObject() {}
     RedisObject(Type tc) : _type(tc) {}
-    RedisObject(Type tc, Client &c) : _type(tc) { init(c); }
+    RedisObject(Type tc, const String &d) : data(d), _type(tc) {}
 
     virtual ~RedisObject() {}
 
-    static std::shared_ptr<RedisObject> parseTypeNonBlocking(Client &);
-    static std::shared_ptr<RedisObject> parseType(Client &);
+    /** Parse a reply from whatever `reader` has available, without blocking.
+     *  A partially-received reply is kept by the reader's RedisParser and resumed on the next call.
+     *  @return The reply once complete, `nullptr` while more input is needed.
+     */
+    static std::shared_ptr<RedisObject> parseTypeNonBlocking(RedisReader &);
 
-    /** Initialize a RedisObject instance from the bytestream represented by 'client'.
-     *  Only does very basic (e.g. SimpleString-style) parsing of the object from
-     *  the byte stream. Concrete subclasses are expected to override this to provide
-     *  class-specific parsing & initialization logic.
+    /** Parse a reply from `reader`, waiting for it to arrive in full. Gives up with an
+     *  InternalError if a reply stalls part-way for longer than the Client's timeout.
      */
-    virtual void init(Client &client);
+    static std::shared_ptr<RedisObject> parseType(RedisReader &);
+
+    /** Parse directly from `client` without a persistent RedisReader. Reads no further ahead
+     *  than the reply itself, so are safe to mix with other users of `client`, but forgo buffering.
+     *  Having no reader to keep a partial reply in, the non-blocking variant only avoids blocking
+     *  when no reply has begun to arrive.
+     */
+    static std::shared_ptr<RedisObject> parseTypeNonBlocking(Client &);
+    static std::shared_ptr<RedisObject> parseType(Client &);
 
     /** Produce the Redis serialization protocol (RESP) representation. Must be overridden. */
     virtual String RESP() = 0;
@@ -62,34 +206,71 @@ public:
         return String("(nil)");
     }
 
+    /** @return The type, which determines the class: one of the RESP2 types, or NoType or InternalError */
     Type type() const { return _type; }
 
+    /** @return The type as received, which for a RESP3 reply may be more specific than `type()` (e.g. Map rather than Array) */
+    Type wireType() const { return _wire ? (Type)_wire : _type; }
+
 protected:
+    friend class RedisParser;
+
     String data;
     Type _type = Type::NoType;
+    char _wire = '\0';
 };
 
 /** A Simple String: https://redis.io/topics/protocol#resp-simple-strings */
 class RedisSimpleString : public RedisObject
 {
 public:
-    RedisSimpleString(Client &c) : RedisObject(Type::SimpleString, c) {}
+    RedisSimpleString(const String &s) : RedisObject(Type::SimpleString, s) {}
     ~RedisSimpleString() override {}
 
+    /** The text, valid for as long as this is; empty for a RedisInteger, which holds no text (see `value()`) */
+    const char *c_str() const { return data.c_str(); }
+
     virtual String RESP() override;
 };
 
-/** A Bulk String: https://redis.io/topics/protocol#resp-bulk-strings */
+/** A Bulk String: https://redis.io/topics/protocol#resp-bulk-strings
+ *
+ *  Bulk strings are binary-safe: the payload is held with an explicit length in a single
+ *  allocation (plus a terminating NUL for convenience), and may contain any bytes including NUL.
+ */
 class RedisBulkString : public RedisObject
 {
 public:
-    RedisBulkString(Client &c) : RedisObject(Type::BulkString, c) { init(c); }
-    RedisBulkString(String &s) : RedisObject(Type::BulkString) { data = s; }
-    ~RedisBulkString() override {}
+    /** A "Null Bulk String" */
+    RedisBulkString() : RedisObject(Type::BulkString) {}
+    RedisBulkString(const String &s) : RedisBulkString((const uint8_t *)s.c_str(), s.length()) {}
+    RedisBulkString(const uint8_t *buf, size_t len);
+    ~RedisBulkString() override;
+
+    RedisBulkString(const RedisBulkString &) = delete;
+    RedisBulkString &operator=(const RedisBulkString &) = delete;
 
-    virtual void init(Client &client) override;
+    /** @return The payload, or `nullptr` for a Null Bulk String */
+    const uint8_t *bytes() const { return _buf; }
+
+    /** @return The payload length in bytes */
+    size_t length() const { return _len; }
+
+    bool isNilReturn() const { return _buf == nullptr; }
+
+    /** The payload as a String; binary-safe where the platform's String is (e.g. ESP8266, ESP32) */
+    virtual operator String() override;
 
     virtual String RESP() override;
+
+private:
+    friend class RedisParser;
+
+    void allocate(size_t len);
+
+    uint8_t *_buf = nullptr;
+    size_t _len = 0;
+    bool _owned = true;
 };
 
 /** An Array: https://redis.io/topics/protocol#resp-arrays */
@@ -97,11 +278,20 @@ class RedisArray : public RedisObject
 {
 public:
     RedisArray() : RedisObject(Type::Array) {}
-    RedisArray(Client &c) : RedisObject(Type::Array, c) { init(c); }
     ~RedisArray() override { vec.empty(); }
 
     void add(std::shared_ptr<RedisObject> param) { vec.push_back(param); }
 
+    /** The number of (top-level) elements */
+    size_t size() const { return vec.size(); }
+
+    /** The element at `index`, or `nullptr` if out of range */
+    std::shared_ptr<RedisObject> at(size_t index) const { return index < vec.size() ? vec[index] : nullptr; }
+
+    /** For a RESP3 map, or a RESP2 array of alternating keys and values (as from HGETALL or XINFO):
+     *  @return The value of the first string key equal to `key`, or `nullptr` if there is none */
+    std::shared_ptr<RedisObject> lookup(const char *key) const;
+
     /** If this is a nested array, will flatten all those within */
     operator std::vector<String>() const;
 
@@ -112,30 +302,67 @@ public:
      */
     bool isNilReturn() const { return data.toInt() == -1; }
 
-    virtual void init(Client &client) override;
-
     virtual String RESP() override;
 
 protected:
+    friend class RedisParser;
+
     std::vector<std::shared_ptr<RedisObject>> vec;
 };
 
-/** An Integer: https://redis.io/topics/protocol#resp-integers */
+/** An Integer: https://redis.io/topics/protocol#resp-integers
+ *  The value is parsed straight from the wire into 64 bits, and only formatted as text if asked to be.
+ */
 class RedisInteger : public RedisSimpleString
 {
 public:
-    RedisInteger(Client &c) : RedisSimpleString(c) { _type = Type::Integer; }
+    RedisInteger(int64_t value) : RedisSimpleString(String()), _value(value) { _type = Type::Integer; }
+    RedisInteger(const String &s);
     ~RedisInteger() override {}
 
-    operator int() { return data.toInt(); }
-    operator bool() { return (bool)operator int(); }
+    /** The value in full, e.g. a counter or a PTTL beyond the range of an `int` */
+    int64_t value() const { return _value; }
+
+    /** The value truncated to an `int`; use `value()` for the full range */
+    operator int() { return (int)_value; }
+    operator bool() { return _value != 0; }
+
+    virtual operator String() override;
+
+    virtual String RESP() override;
+
+    /** Parse the decimal integer of `len` bytes at `str` (an optional sign, then digits only).
+     *  @return `false` if it isn't one, or is beyond the range of `int64_t`.
+     */
+    static bool parse(const char *str, size_t len, int64_t &value);
+
+private:
+    int64_t _value;
+};
+
+/** A RESP3 Double: presented by `type()` as a SimpleString of its text, as ever, but parsed once as it arrives */
+class RedisDouble : public RedisSimpleString
+{
+public:
+    RedisDouble(const String &s, double value) : RedisSimpleString(s), _value(value) {}
+    ~RedisDouble() override {}
+
+    double value() const { return _value; }
+
+    /** Parse the double of `len` bytes at `str`, NUL-terminated: as Redis formats one, or "inf", "-inf" or "nan".
+     *  @return `false` if it isn't one.
+     */
+    static bool parse(const char *str, size_t len, double &value);
+
+private:
+    double _value;
 };
 
 /** An Error: https://redis.io/topics/protocol#resp-errors */
 class RedisError : public RedisSimpleString
 {
 public:
-    RedisError(Client &c) : RedisSimpleString(c) { _type = Type::Error; }
+    RedisError(const String &s) : RedisSimpleString(s) { _type = Type::Error; }
     ~RedisError() override {}
 };
 
@@ -148,6 +375,8 @@ public:
         UnknownError = -254,
         UnknownType,
         Disconnected,
+        /// A number that doesn't parse, or is beyond the range of its type; the replies that follow are unaffected.
+        MalformedReply,
         NoError = 0
     } RedisInternalErrorCode;
 
@@ -164,6 +393,346 @@ protected:
     RedisInternalErrorCode _code;
 };
 
+/** Receives the elements of a reply one at a time, as they are parsed off the wire, in place of
+ *  the reply being assembled as a tree. See `RedisCommand::issue()`.
+ *
+ *  Depth counts nesting: a top-level reply is at depth 0, the elements of a top-level array at
+ *  depth 1, and so on.
+ */
+class RedisVisitor
+{
+public:
+    virtual ~RedisVisitor() {}
+
+    /** An aggregate of `count` elements begins at `depth`; its elements follow at `depth + 1`.
+     *  `count` is -1 for a Null Array, and counts keys and values separately for a map.
+     */
+    virtual void aggregate(RedisObject::Type type, long count, size_t depth)
+    {
+        (void)type;
+        (void)count;
+        (void)depth;
+    }
+
+    /** A non-aggregate element. `data` is `nullptr` for a Null Bulk String, and is only valid
+     *  for the duration of the call.
+     */
+    virtual void element(RedisObject::Type type, const uint8_t *data, size_t length, size_t depth) = 0;
+};
+
+/** A bump allocator holding every object of one parsed reply in a few contiguous blocks.
+ *  Nothing is freed individually: the blocks are released together once the last object
+ *  allocated from the arena is destroyed, so retaining any one element of a reply retains
+ *  the memory of all of it.
+ */
+class RedisArena
+{
+public:
+    RedisArena() {}
+    ~RedisArena();
+
+    RedisArena(const RedisArena &) = delete;
+    RedisArena &operator=(const RedisArena &) = delete;
+
+    /** @return `size` bytes aligned to `align`, or `nullptr` if the heap is exhausted */
+    void *allocate(size_t size, size_t align);
+
+private:
+    // padded to the alignment of malloc()'s results, so that the payload following it is as aligned
+    typedef struct alignas(std::max_align_t) Block
+    {
+        Block *next;
+        size_t cap;
+        size_t used;
+    } Block;
+
+    Block *_head = nullptr;
+};
+
+/** A standard allocator drawing from a RedisArena, for use with `std::allocate_shared`.
+ *  Each allocation keeps the arena alive, so it outlives whichever parser created it.
+ */
+template <typename T>
+class RedisArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    RedisArenaAllocator(std::shared_ptr<RedisArena> arena) : _arena(arena) {}
+
+    template <typename U>
+    RedisArenaAllocator(const RedisArenaAllocator<U> &other) : _arena(other._arena) {}
+
+    T *allocate(size_t n) { return (T *)_arena->allocate(n * sizeof(T), alignof(T)); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const RedisArenaAllocator<U> &other) const { return _arena == other._arena; }
+    template <typename U>
+    bool operator!=(const RedisArenaAllocator<U> &other) const { return _arena != other._arena; }
+
+private:
+    template <typename U>
+    friend class RedisArenaAllocator;
+
+    std::shared_ptr<RedisArena> _arena;
+};
+
+/** A resumable RESP parser. Rather than reading a reply in one go, it consumes whatever input is
+ *  available and keeps its place between calls: the nesting of open arrays (and the elements each
+ *  still expects), the remaining length of a bulk string, or a partially received line. A reply
+ *  that trickles in over many calls therefore never blocks the caller.
+ */
+class RedisParser
+{
+public:
+    /** Consume as much of `reader`'s available input as the current reply needs, without blocking.
+     *  @return The reply once complete (possibly an InternalError for unparseable input),
+     *  `nullptr` if more input is required.
+     */
+    std::shared_ptr<RedisObject> feed(RedisReader &reader);
+
+    /** @return `true` if part of a reply has been consumed but the reply is not yet complete */
+    bool inProgress() const { return _state != ReadType || _stack.size(); }
+
+    /** Discard any partially parsed reply */
+    void reset();
+
+    /** Have the payload of the next reply, if it is a bulk string of at most `cap` bytes, written
+     *  directly into `buf` rather than a new allocation. The resulting RedisBulkString then refers
+     *  to `buf`, and must not outlive it. Cleared once that reply completes, or by passing `nullptr`.
+     */
+    void setBulkTarget(uint8_t *buf, size_t cap)
+    {
+        _target = buf;
+        _targetCap = cap;
+    }
+
+    /** Called with each element that completes at the nesting depth given to `setElementSink()` */
+    typedef void (*ElementSink)(std::shared_ptr<RedisObject> element, void *context);
+
+    /** Have each element at `depth` of the next reply (the reply itself being depth 0, the elements
+     *  of a top-level array depth 1, and so on) handed to `sink` as soon as it completes, rather than
+     *  attached to its parent array. Only one such element need then be held at a time, however long
+     *  the reply. Cleared once that reply completes, or by passing `nullptr`.
+     */
+    void setElementSink(size_t depth, ElementSink sink, void *context)
+    {
+        _sinkDepth = depth;
+        _sink = sink;
+        _sinkContext = context;
+    }
+
+    /** Have the next reply handed to `visitor` element by element rather than assembled as a tree;
+     *  `feed()` then returns the top-level object alone (an aggregate without its elements).
+     *  Cleared once that reply completes, or by passing `nullptr`.
+     */
+    void setVisitor(RedisVisitor *visitor) { _visitor = visitor; }
+
+    /** @return `true` if an element sink or visitor is set, which would have to see a reply again were it re-read */
+    bool hooked() const { return _sink || _visitor; }
+
+    // what setBulkTarget(), setElementSink() & setVisitor() set for the next reply
+    typedef struct
+    {
+        uint8_t *target;
+        size_t targetCap;
+        size_t sinkDepth;
+        ElementSink sink;
+        void *sinkContext;
+        RedisVisitor *visitor;
+    } Hooks;
+
+    /** Clear the hooks set for the next reply, so that other replies (e.g. those still outstanding to commands
+     *  written earlier) can be read ahead of it; they are put back with `setHooks()`.
+     */
+    Hooks takeHooks();
+    void setHooks(const Hooks &hooks);
+
+    /** Parse each subsequent reply into its own RedisArena: the whole object tree, bulk payloads
+     *  included, then costs a handful of heap allocations rather than several per element,
+     *  and is freed in one go. Defaults to `REDIS_USE_ARENA`.
+     */
+    void setArena(bool enabled) { _useArena = enabled; }
+
+private:
+    typedef enum
+    {
+        ReadType,
+        ReadLine,
+        ReadLineEnd,
+        ReadBulk,
+        ReadBulkEnd,
+    } State;
+
+    typedef struct
+    {
+        std::shared_ptr<RedisArray> array;
+        long remaining;
+    } Frame;
+
+    size_t wanted() const;
+    template <typename T, typename... Args>
+    std::shared_ptr<RedisObject> create(Args &&...args);
+    std::shared_ptr<RedisObject> createNode(char type, const String &line);
+    std::shared_ptr<RedisObject> header();
+    std::shared_ptr<RedisObject> complete(std::shared_ptr<RedisObject> node);
+    void visit(const std::shared_ptr<RedisObject> &node);
+    void finish();
+
+    State _state = ReadType;
+    char _type = RedisObject::Type::NoType;
+    String _line;
+    std::shared_ptr<RedisBulkString> _bulk;
+    long _bulkRemaining = 0;
+    std::vector<Frame> _stack;
+    uint8_t *_target = nullptr;
+    size_t _targetCap = 0;
+    bool _useArena = REDIS_USE_ARENA;
+    std::shared_ptr<RedisArena> _arena;
+    size_t _sinkDepth = 0;
+    ElementSink _sink = nullptr;
+    void *_sinkContext = nullptr;
+    RedisVisitor *_visitor = nullptr;
+    // set aside while a RESP3 push frame, which may arrive ahead of any reply, is parsed
+    bool _inPush = false;
+    Hooks _pushed = {};
+};
+
+/** Buffers reads from a Client so the RESP parser can pull replies in bulk chunks and find
+ *  line terminators with memchr(), rather than calling into the network stack once per byte.
+ *  Also holds the RedisParser state of any reply that has only partially arrived.
+ *
+ *  Bytes read ahead belong to whatever comes next on the connection, so a reader must persist
+ *  for as long as its Client is in use (each Redis instance owns one). A reader constructed with
+ *  `readAhead` false never consumes more than the parser asks for, and so may be used transiently.
+ */
+class RedisReader
+{
+public:
+    RedisReader(Client &client, bool readAhead = true) : _client(client), _readAhead(readAhead) {}
+
+    RedisReader(const RedisReader &) = delete;
+    RedisReader &operator=(const RedisReader &) = delete;
+
+    Client &client() { return _client; }
+    RedisParser &parser() { return _parser; }
+
+    /** Called with each RESP3 push frame read, rather than it being returned as a reply */
+    typedef void (*PushHandler)(std::shared_ptr<RedisObject> push, void *context);
+
+    /** Have RedisObject::parseType() & parseTypeNonBlocking() hand each RESP3 push frame (e.g. a pub/sub
+     *  message or a CLIENT TRACKING invalidation) to `handler`, and carry on to the reply proper.
+     *  Without a handler, a push frame is returned like any reply. The handler must not issue commands:
+     *  their replies would be read out of order.
+     */
+    void setPushHandler(PushHandler handler, void *context)
+    {
+        _pushHandler = handler;
+        _pushContext = context;
+    }
+
+    PushHandler pushHandler() const { return _pushHandler; }
+    void *pushContext() const { return _pushContext; }
+
+    /** Called when the connection is found lost, by a command (named by the `len` bytes at `command`) or,
+     *  with `command` `nullptr`, by a subscriber polling for messages; see RedisConnection.
+     *  @return `true` if the connection has been restored and, for a command, it should be issued again */
+    typedef bool (*DisconnectHandler)(const char *command, size_t len, void *context);
+
+    /** Have commands that find the connection lost (before anything of their reply was read) call `handler` */
+    void setDisconnectHandler(DisconnectHandler handler, void *context)
+    {
+        _disconnectHandler = handler;
+        _disconnectContext = context;
+    }
+
+    DisconnectHandler disconnectHandler() const { return _disconnectHandler; }
+
+    /** Called before each command is written, to read the replies still outstanding to any written earlier */
+    typedef void (*PendingHandler)(void *context);
+
+    void setPendingHandler(PendingHandler handler, void *context)
+    {
+        _pendingHandler = handler;
+        _pendingContext = context;
+    }
+
+    /** Read every reply outstanding, so that the next read is of the reply to the next command written */
+    void settle()
+    {
+        if (!_pendingHandler)
+            return;
+
+        // any hooks already set are for the reply to that command, not those outstanding
+        auto hooks = _parser.takeHooks();
+        _pendingHandler(_pendingContext);
+        _parser.setHooks(hooks);
+    }
+
+    /** @return `true` if the disconnect handler restored the connection, and `command` (if any) may be retried */
+    bool reconnect(const char *command, size_t len)
+    {
+        return _disconnectHandler && _disconnectHandler(command, len, _disconnectContext);
+    }
+
+    /** Discard anything buffered or partly parsed, as of a connection since lost */
+    void reset()
+    {
+        _head = _tail = 0;
+        _parser.reset();
+    }
+
+    /** @return `true` if data remains to be read, either buffered or from a connected Client */
+    bool connected() { return buffered() || _client.connected(); }
+
+    /** @return The number of bytes readable without blocking */
+    int available();
+
+    /** @return The number of bytes already buffered */
+    size_t buffered() const { return _tail - _head; }
+
+    /** Ensure some input is buffered, reading (up to `want` bytes, if not reading ahead) from
+     *  the Client only if it already has data available.
+     *  @return `true` if at least one byte is buffered */
+    bool poll(size_t want = 1) { return buffered() || fill(want); }
+
+    /** The buffered bytes, of which there are `buffered()` */
+    const uint8_t *peek() const { return _buf + _head; }
+
+    /** Discard `len` (<= `buffered()`) bytes from the front of the buffer */
+    void consume(size_t len)
+    {
+        _head += len;
+        _consumed += len;
+    }
+
+    /** @return The total number of bytes consumed over the reader's lifetime */
+    unsigned long consumed() const { return _consumed; }
+
+    /** When nothing is buffered, read up to `len` bytes the Client has available straight into `dst`,
+     *  bypassing the buffer; used for large bulk payloads.
+     *  @return The number of bytes read */
+    size_t readDirect(uint8_t *dst, size_t len);
+
+private:
+    bool fill(size_t want);
+
+    Client &_client;
+    bool _readAhead;
+    RedisParser _parser;
+    PushHandler _pushHandler = nullptr;
+    void *_pushContext = nullptr;
+    DisconnectHandler _disconnectHandler = nullptr;
+    void *_disconnectContext = nullptr;
+    PendingHandler _pendingHandler = nullptr;
+    void *_pendingContext = nullptr;
+    size_t _head = 0;
+    size_t _tail = 0;
+    unsigned long _consumed = 0;
+    uint8_t _buf[REDIS_READER_BUFFER_SIZE];
+};
+
 /** A Command (a specialized Array subclass): https://redis.io/topics/protocol#sending-commands-to-a-redis-server */
 class RedisCommand : public RedisArray
 {
@@ -192,10 +761,94 @@ public:
     std::shared_ptr<RedisObject> issue(Client &cmdClient);
 
     template <typename T>
-    T issue_typed(Client &cmdClient);
+    T issue_typed(Client &cmdClient) { return convert_typed<T>(issue(cmdClient)); }
+
+    /** As above, reading the reply through the connection's persistent `reader`. */
+    std::shared_ptr<RedisObject> issue(RedisReader &reader);
+
+    /** Issue a command without constructing a RedisCommand: `cmdAndArgs` (the command name followed
+     *  by its arguments) is streamed directly to `cmdClient` by RedisEncoder, allocating nothing.
+     *  @return As for the non-static `issue()`.
+     */
+    static std::shared_ptr<RedisObject> issue(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs);
+    static std::shared_ptr<RedisObject> issue(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs);
+
+    /** As above, for argument lists built up at runtime. */
+    static std::shared_ptr<RedisObject> issue(Client &cmdClient, const String &command, const ArgList &args);
+    static std::shared_ptr<RedisObject> issue(RedisReader &reader, const String &command, const ArgList &args);
+
+    /** Issue a command, handing each element of the reply to `visitor` as it is parsed off the wire
+     *  instead of assembling the reply in memory: peak memory is then bounded by the largest single
+     *  element, not the size of the whole reply.
+     *  @return The top-level reply alone: an aggregate without its elements (so its type, and whether it
+     *  is nil, can still be checked), or the reply itself if it was not an aggregate (e.g. an error).
+     */
+    static std::shared_ptr<RedisObject> issue(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs, RedisVisitor &visitor);
+    static std::shared_ptr<RedisObject> issue(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs, RedisVisitor &visitor);
+    static std::shared_ptr<RedisObject> issue(Client &cmdClient, const String &command, const ArgList &args, RedisVisitor &visitor);
+    static std::shared_ptr<RedisObject> issue(RedisReader &reader, const String &command, const ArgList &args, RedisVisitor &visitor);
+
+    template <typename T>
+    static T issue_typed(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs)
+    {
+        return convert_typed<T>(issue(cmdClient, cmdAndArgs));
+    }
+
+    template <typename T>
+    static T issue_typed(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs)
+    {
+        return convert_typed<T>(issue(reader, cmdAndArgs));
+    }
+
+    /** Convert a parsed reply into the simple C++ type `T`, using the same rules as `issue_typed()`.
+     *  Exposed so that replies read outside of `issue()` (e.g. via `RedisPipeline`) convert identically.
+     */
+    template <typename T>
+    static T convert_typed(std::shared_ptr<RedisObject> reply);
+
+    /** Convert a parsed reply into `T`: `int64_t`, `int`, `double`, `bool` or `String`. Unlike `convert_typed()`,
+     *  no value doubles as an error: a number may be read from an integer reply or from text (as GET returns), and
+     *  a double also from a RESP3 double (as INCRBYFLOAT or ZSCORE return), but anything else sets `status`.
+     */
+    template <typename T>
+    static RedisResult<T> convert_result(std::shared_ptr<RedisObject> reply);
+
+    template <typename T>
+    static RedisResult<T> issue_result(Client &cmdClient, std::initializer_list<RedisArg> cmdAndArgs)
+    {
+        return convert_result<T>(issue(cmdClient, cmdAndArgs));
+    }
+
+    template <typename T>
+    static RedisResult<T> issue_result(RedisReader &reader, std::initializer_list<RedisArg> cmdAndArgs)
+    {
+        return convert_result<T>(issue(reader, cmdAndArgs));
+    }
 
 private:
     String _err;
 };
 
+template <>
+int RedisCommand::convert_typed<int>(std::shared_ptr<RedisObject>);
+template <>
+bool RedisCommand::convert_typed<bool>(std::shared_ptr<RedisObject>);
+template <>
+String RedisCommand::convert_typed<String>(std::shared_ptr<RedisObject>);
+template <>
+int64_t RedisCommand::convert_typed<int64_t>(std::shared_ptr<RedisObject>);
+template <>
+double RedisCommand::convert_typed<double>(std::shared_ptr<RedisObject>);
+
+template <>
+RedisResult<int64_t> RedisCommand::convert_result<int64_t>(std::shared_ptr<RedisObject>);
+template <>
+RedisResult<int> RedisCommand::convert_result<int>(std::shared_ptr<RedisObject>);
+template <>
+RedisResult<double> RedisCommand::convert_result<double>(std::shared_ptr<RedisObject>);
+template <>
+RedisResult<bool> RedisCommand::convert_result<bool>(std::shared_ptr<RedisObject>);
+template <>
+RedisResult<String> RedisCommand::convert_result<String>(std::shared_ptr<RedisObject>);
+
 #endif // REDIS_INTERNAL_H
@@ -0,0 +1,76 @@
+#include "RedisPipeline.h"
+
+void RedisPipeline::startBatch()
+{
+  if (replies.size())
+  {
+    clear();
+  }
+}
+
+RedisPipeline::Slot RedisPipeline::queue(String command, ArgList args)
+{
+  startBatch();
+  RedisEncoder(outbound).command(command, args);
+  return count++;
+}
+
+RedisPipeline::Slot RedisPipeline::queue(std::initializer_list<RedisArg> cmdAndArgs)
+{
+  startBatch();
+  RedisEncoder(outbound).command(cmdAndArgs);
+  return count++;
+}
+
+bool RedisPipeline::exec()
+{
+  redis.wait();
+  replies.clear();
+  replies.reserve(count);
+
+  if (!count)
+  {
+    return true;
+  }
+
+  if (!redis.conn.connected())
+  {
+    replies.assign(count, std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected)));
+    return false;
+  }
+
+  redis.conn.write(outbound.bytes.data(), outbound.bytes.size());
+  outbound.bytes.clear();
+
+  std::shared_ptr<RedisObject> lost;
+  for (size_t i = 0; i < count; i++)
+  {
+    auto ret = lost ? lost : RedisObject::parseType(*redis.reader);
+
+    // once a reply has timed out or the connection is lost, no later one can be told apart from it (a malformed
+    // number aside, which leaves the replies in step): the rest fail with it rather than being read into the
+    // wrong slots, or waited on in vain
+    if (!lost && (!ret || (ret->type() == RedisObject::Type::InternalError &&
+                           ((RedisInternalError *)ret.get())->code() != RedisInternalError::MalformedReply)))
+    {
+      lost = ret ? ret : std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+      ret = lost;
+    }
+
+    replies.push_back(ret);
+  }
+
+  return !lost;
+}
+
+void RedisPipeline::clear()
+{
+  outbound.bytes.clear();
+  count = 0;
+  replies.clear();
+}
+
+std::shared_ptr<RedisObject> RedisPipeline::reply(Slot slot) const
+{
+  return slot < replies.size() ? replies[slot] : nullptr;
+}
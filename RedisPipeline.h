@@ -0,0 +1,100 @@
+#ifndef REDIS_PIPELINE_H
+#define REDIS_PIPELINE_H
+
+#include "Redis.h"
+#include "RedisInternal.h"
+
+/** Batches commands to a `Redis` instance so they are written in a single flush,
+ *  with all replies then read back in order: N commands cost one round trip rather than N.
+ *
+ *  Usage:
+ *  @code
+ *  RedisPipeline pipe(redis);
+ *  auto first = pipe.queue("HSET", ArgList{"device", "temp", "21"});
+ *  auto second = pipe.queue("XADD", ArgList{"events", "*", "temp", "21"});
+ *  if (pipe.exec())
+ *  {
+ *    int added = pipe.reply_typed<int>(first);
+ *    String id = pipe.reply_typed<String>(second);
+ *  }
+ *  @endcode
+ *
+ *  A pipeline may be reused: calling `queue()` after `exec()` starts a new batch.
+ */
+class RedisPipeline
+{
+public:
+  /** An index into the reply slots of an executed pipeline, as returned by `queue()` */
+  typedef size_t Slot;
+
+  /**
+   * Create a pipeline issuing commands over the connection of `redis`.
+   * @param redis The Redis instance whose connection will carry the batch. Must outlive the pipeline.
+   */
+  RedisPipeline(Redis &redis) : redis(redis) {}
+
+  ~RedisPipeline() {}
+  RedisPipeline(const RedisPipeline &) = delete;
+  RedisPipeline &operator=(const RedisPipeline &) = delete;
+
+  /**
+   * Queue `command` with arguments `args`. Nothing is sent until `exec()` is called.
+   * @param command The command name, e.g. "HSET".
+   * @param args The command's arguments.
+   * @return The slot from which this command's reply may be retrieved after `exec()`.
+   */
+  Slot queue(String command, ArgList args = ArgList());
+
+  /**
+   * Queue a command given as its name followed by its arguments, e.g. `queue({"HSET", key, field, value})`.
+   * The arguments are encoded immediately, so they need not outlive this call.
+   * @return The slot from which this command's reply may be retrieved after `exec()`.
+   */
+  Slot queue(std::initializer_list<RedisArg> cmdAndArgs);
+
+  /**
+   * Write all queued commands in a single flush, then read every reply in order.
+   * @return `true` if a reply was read for every queued command, `false` if the connection
+   * was lost (slots without a reply will hold a `RedisInternalError`).
+   */
+  bool exec();
+
+  /**
+   * The number of commands queued in the current batch.
+   */
+  size_t size() const { return count; }
+
+  /**
+   * Discard any queued commands and replies.
+   */
+  void clear();
+
+  /**
+   * The reply read for the command queued at `slot`.
+   * @return The parsed reply, or `nullptr` if `slot` is out of range or `exec()` has not been called.
+   */
+  std::shared_ptr<RedisObject> reply(Slot slot) const;
+
+  /**
+   * The reply read for the command queued at `slot`, converted as `RedisCommand::issue_typed()` would.
+   */
+  template <typename T>
+  T reply_typed(Slot slot) const { return RedisCommand::convert_typed<T>(reply(slot)); }
+
+  /**
+   * The reply to the command queued at `slot`, converted as `RedisCommand::convert_result()` would.
+   */
+  template <typename T>
+  RedisResult<T> reply_result(Slot slot) const { return RedisCommand::convert_result<T>(reply(slot)); }
+
+private:
+  void startBatch();
+
+  Redis &redis;
+  // the encoded batch, until `exec()` writes it in one call
+  RedisOutbound outbound;
+  size_t count = 0;
+  std::vector<std::shared_ptr<RedisObject>> replies;
+};
+
+#endif // REDIS_PIPELINE_H
@@ -0,0 +1,78 @@
+#include "RedisPool.h"
+
+RedisPool::Lease &RedisPool::Lease::operator=(Lease &&other)
+{
+  if (this != &other)
+  {
+    release();
+    _pool = other._pool;
+    _index = other._index;
+    other._pool = nullptr;
+  }
+  return *this;
+}
+
+void RedisPool::Lease::release()
+{
+  if (_pool)
+  {
+    _pool->_leased[_index].store(false, std::memory_order_release);
+    _pool = nullptr;
+  }
+}
+
+RedisPool::RedisPool(std::vector<Redis *> connections)
+    : _connections(connections), _leased(new std::atomic<bool>[connections.size()]), _next(0)
+{
+  for (size_t i = 0; i < _connections.size(); i++)
+  {
+    _leased[i].store(false);
+  }
+}
+
+RedisPool::~RedisPool()
+{
+  delete[] _leased;
+}
+
+RedisPool::Lease RedisPool::tryAcquire()
+{
+  auto count = _connections.size();
+  auto start = count ? _next.fetch_add(1, std::memory_order_relaxed) % count : 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    auto index = (start + i) % count;
+    bool expected = false;
+    // acquiring, so that the lease sees everything done with the connection under the last
+    if (_leased[index].compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+      return Lease(this, index);
+    }
+  }
+  return Lease();
+}
+
+RedisPool::Lease RedisPool::acquire(unsigned long timeoutMs)
+{
+  auto start = millis();
+  while (true)
+  {
+    auto lease = tryAcquire();
+    if (lease || millis() - start >= timeoutMs)
+    {
+      return lease;
+    }
+    // sleeping rather than yielding lets a task of lower priority run, and so return its lease
+    delay(1);
+  }
+}
+
+size_t RedisPool::available() const
+{
+  size_t free = 0;
+  for (size_t i = 0; i < _connections.size(); i++)
+  {
+    free += !_leased[i].load(std::memory_order_relaxed);
+  }
+  return free;
+}
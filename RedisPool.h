@@ -0,0 +1,98 @@
+#ifndef REDIS_POOL_H
+#define REDIS_POOL_H
+
+#include "Redis.h"
+
+#include <atomic>
+
+/** Shares several Redis connections between tasks (e.g. FreeRTOS tasks on both cores of an ESP32), each
+ *  command or sequence of commands being issued on a connection leased for the purpose, so that tasks neither
+ *  serialize on one connection nor need any locking of their own.
+ *
+ *  Leasing costs an atomic compare-and-swap per connection tried, and never allocates; a lease is returned to
+ *  the pool when it goes out of scope.
+ *
+ *  Usage:
+ *  @code
+ *  WiFiClient clientA, clientB;
+ *  Redis redisA(clientA), redisB(clientB); // each connected (and authenticated) as usual
+ *  RedisPool pool({&redisA, &redisB});
+ *
+ *  // in any task:
+ *  if (auto redis = pool.acquire(100))
+ *  {
+ *    redis->set("uptime", String(millis()).c_str());
+ *  }
+ *  @endcode
+ *
+ *  Each connection may be a `RedisConnection`'s (see `RedisConnection::redis()`), to be restored should it be lost.
+ *  Subscribing through a leased connection would keep it from the pool; use a connection of its own.
+ */
+class RedisPool
+{
+public:
+  /** Exclusive use of one of the pool's connections, for as long as it is held */
+  class Lease
+  {
+  public:
+    Lease() {}
+    Lease(Lease &&other) : _pool(other._pool), _index(other._index) { other._pool = nullptr; }
+    Lease &operator=(Lease &&other);
+    ~Lease() { release(); }
+
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    /** @return `true` if a connection was leased */
+    explicit operator bool() const { return _pool != nullptr; }
+
+    Redis *operator->() const { return _pool->_connections[_index]; }
+    Redis &operator*() const { return *_pool->_connections[_index]; }
+
+    /** Return the connection to the pool before the lease goes out of scope */
+    void release();
+
+  private:
+    friend class RedisPool;
+    Lease(RedisPool *pool, size_t index) : _pool(pool), _index(index) {}
+
+    RedisPool *_pool = nullptr;
+    size_t _index = 0;
+  };
+
+  /**
+   * @param connections The connections to share, each of which must outlive the pool and every lease on it.
+   */
+  RedisPool(std::vector<Redis *> connections);
+  ~RedisPool();
+
+  RedisPool(const RedisPool &) = delete;
+  RedisPool &operator=(const RedisPool &) = delete;
+
+  /**
+   * Lease a connection, if one is free, without waiting.
+   * @return The lease, which converts to `false` if every connection was leased already.
+   */
+  Lease tryAcquire();
+
+  /**
+   * Lease a connection, waiting (and yielding to other tasks) until one is free.
+   * @param timeoutMs The longest to wait, in milliseconds.
+   * @return The lease, which converts to `false` if none was free in time.
+   */
+  Lease acquire(unsigned long timeoutMs);
+
+  /** @return The number of connections shared */
+  size_t size() const { return _connections.size(); }
+
+  /** @return The number of connections not leased at the moment */
+  size_t available() const;
+
+private:
+  std::vector<Redis *> _connections;
+  std::atomic<bool> *_leased;
+  // where the next search for a free connection starts, spreading the leases over every connection
+  std::atomic<size_t> _next;
+};
+
+#endif // REDIS_POOL_H
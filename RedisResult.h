@@ -0,0 +1,47 @@
+#ifndef REDIS_RESULT_H
+#define REDIS_RESULT_H
+
+#include <memory>
+
+class RedisObject;
+
+/** Whether a reply could be converted by `RedisCommand::convert_result()`, and if not, why */
+typedef enum
+{
+  RedisResultOk = 0,
+  /// The server replied with an error (e.g. WRONGTYPE, or a value that isn't a number), held by `error`.
+  RedisResultError,
+  /// A nil reply, e.g. to GET of a key that doesn't exist.
+  RedisResultNil,
+  /// A reply of a type (or text) that doesn't convert to the type asked for.
+  RedisResultWrongType,
+  /// An integer beyond the range of the type asked for.
+  RedisResultOutOfRange,
+  /// No reply was read: the connection was lost, or the reply timed out. See `error`.
+  RedisResultInternalError,
+} RedisResultStatus;
+
+/** A reply converted to `T`, with whether it could be kept apart from the value rather than signalled by one.
+ *
+ *  Usage:
+ *  @code
+ *  auto count = redis.incr("boots");
+ *  if (count.ok())
+ *  {
+ *    Serial.println((long)count.value);
+ *  }
+ *  @endcode
+ */
+template <typename T>
+struct RedisResult
+{
+  /// The value; `T()` (0, or an empty String) unless `status` is RedisResultOk.
+  T value = T();
+  RedisResultStatus status = RedisResultOk;
+  /// The error reply, for RedisResultError or RedisResultInternalError.
+  std::shared_ptr<RedisObject> error;
+
+  bool ok() const { return status == RedisResultOk; }
+};
+
+#endif // REDIS_RESULT_H
@@ -0,0 +1,153 @@
+#include "RedisScan.h"
+
+static const char *scanCommands[] = {"SCAN", "HSCAN", "SSCAN", "ZSCAN"};
+
+RedisScan::~RedisScan()
+{
+  if (inFlight)
+  {
+    redis.wait();
+  }
+}
+
+void RedisScan::reset()
+{
+  if (inFlight)
+  {
+    redis.wait();
+  }
+
+  cursor = "0";
+  complete = false;
+  fetched = nullptr;
+  page = nullptr;
+  index = 0;
+  failure = nullptr;
+}
+
+void RedisScan::onPage(Redis *, std::shared_ptr<RedisObject> reply, void *context)
+{
+  auto scan = (RedisScan *)context;
+  scan->fetched = reply;
+  scan->inFlight = false;
+}
+
+void RedisScan::request()
+{
+  std::vector<String> args;
+  args.reserve(8);
+  if (type != RedisScanKeys)
+  {
+    args.push_back(key);
+  }
+  args.push_back(cursor);
+  if (match)
+  {
+    args.push_back("MATCH");
+    args.push_back(match);
+  }
+  if (count)
+  {
+    args.push_back("COUNT");
+    args.push_back(String(count));
+  }
+  if (keyType && type == RedisScanKeys)
+  {
+    args.push_back("TYPE");
+    args.push_back(keyType);
+  }
+
+  inFlight = redis.issueAsync(scanCommands[type], args, onPage, this);
+  if (!inFlight)
+  {
+    failure = std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+  }
+}
+
+// Make the next non-empty page current (a page may well be empty, as when MATCH filters out all of its elements).
+// @return `false` once there are no more pages, or the walk has failed
+bool RedisScan::advance()
+{
+  while (true)
+  {
+    page = nullptr;
+    index = 0;
+    if (!fetched)
+    {
+      if (failure || complete)
+      {
+        return false;
+      }
+
+      if (!inFlight)
+      {
+        request();
+        if (!inFlight)
+        {
+          return false;
+        }
+      }
+
+      // completes (in order) any other command issued asynchronously ahead of the page
+      redis.wait();
+    }
+
+    auto reply = fetched;
+    fetched = nullptr;
+
+    // [cursor, [elements...]]
+    if (reply->type() != RedisObject::Type::Array || ((RedisArray *)reply.get())->size() != 2 ||
+        ((RedisArray *)reply.get())->at(1)->type() != RedisObject::Type::Array)
+    {
+      failure = reply;
+      return false;
+    }
+
+    auto parts = (RedisArray *)reply.get();
+
+    cursor = (String)*parts->at(0);
+    complete = cursor == "0";
+    page = parts->at(1);
+
+    if (prefetch && !complete)
+    {
+      request();
+    }
+
+    if (((RedisArray *)page.get())->size())
+    {
+      return true;
+    }
+  }
+}
+
+bool RedisScan::next(String &element)
+{
+  if (!page || index >= ((RedisArray *)page.get())->size())
+  {
+    if (!advance())
+    {
+      return false;
+    }
+  }
+
+  element = (String)*((RedisArray *)page.get())->at(index++);
+  return true;
+}
+
+bool RedisScan::next(String &element, String &value)
+{
+  // elements come in pairs, never split across pages
+  if (!page || index + 1 >= ((RedisArray *)page.get())->size())
+  {
+    if (!advance())
+    {
+      return false;
+    }
+  }
+
+  auto elements = (RedisArray *)page.get();
+  element = (String)*elements->at(index++);
+  value = (String)*elements->at(index++);
+  return true;
+}
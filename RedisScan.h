@@ -0,0 +1,118 @@
+#ifndef REDIS_SCAN_H
+#define REDIS_SCAN_H
+
+#include "Redis.h"
+#include "RedisInternal.h"
+
+/** What a RedisScan walks, and so the command with which it does */
+typedef enum
+{
+  /// The keyspace, with SCAN.
+  RedisScanKeys = 0,
+  /// The fields and values of a hash, with HSCAN.
+  RedisScanHash,
+  /// The members of a set, with SSCAN.
+  RedisScanSet,
+  /// The members and scores of a sorted set, with ZSCAN.
+  RedisScanSortedSet,
+} RedisScanType;
+
+/** Walks the keyspace, or the elements of a hash, set or sorted set, with the SCAN family of commands rather than
+ *  KEYS (or HGETALL, SMEMBERS...), which would block the server while it builds one reply holding every element.
+ *  Pages are fetched lazily, as the elements of the last are consumed, so at most one page (two, when prefetching)
+ *  is held in memory however large the keyspace: its size is set with `setCount()`.
+ *
+ *  With `setPrefetch(true)`, the next page is requested as soon as one arrives (as by `Redis::issueAsync()`), so
+ *  that it is in flight while the current one is consumed rather than a round trip being waited upon per page.
+ *
+ *  Usage:
+ *  @code
+ *  RedisScan scan(redis);
+ *  scan.setMatch("sensor:*");
+ *  scan.setCount(100);
+ *  String key;
+ *  while (scan.next(key))
+ *  {
+ *    redis.expire(key.c_str(), 3600);
+ *  }
+ *
+ *  RedisScan fields(redis, RedisScanHash, "device:1");
+ *  String field, value;
+ *  while (fields.next(field, value)) { ... }
+ *  @endcode
+ *
+ *  As with SCAN itself, an element present throughout the walk is returned at least once (possibly more), and
+ *  keys may be modified (or deleted) as they are walked. Other commands may be issued on the connection meanwhile.
+ */
+class RedisScan
+{
+public:
+  /**
+   * @param redis The Redis instance over whose connection to scan. Must outlive this.
+   * @param type What to walk.
+   * @param key The hash, set or sorted set to walk; unused with RedisScanKeys. Must outlive this.
+   */
+  RedisScan(Redis &redis, RedisScanType type = RedisScanKeys, const char *key = nullptr)
+      : redis(redis), type(type), key(key) {}
+
+  /** Waits for any page still in flight, since its reply is delivered to this */
+  ~RedisScan();
+  RedisScan(const RedisScan &) = delete;
+  RedisScan &operator=(const RedisScan &) = delete;
+
+  /** Only return elements (keys, fields or members) matching the glob-style `pattern` (MATCH). Must outlive this. */
+  void setMatch(const char *pattern) { match = pattern; }
+
+  /** Ask for about `count` elements per page (COUNT), rather than the server's default of 10 */
+  void setCount(unsigned int count) { this->count = count; }
+
+  /** Only return keys of `keyType`, e.g. "hash" (TYPE); RedisScanKeys only. Must outlive this. */
+  void setKeyType(const char *keyType) { this->keyType = keyType; }
+
+  /** Request the next page while the current one is consumed */
+  void setPrefetch(bool prefetch) { this->prefetch = prefetch; }
+
+  /**
+   * The next key, or set member.
+   * @return `false` once the walk is complete, or has failed (see `error()`).
+   */
+  bool next(String &element);
+
+  /**
+   * The next field and value of a hash, or member and score of a sorted set.
+   * @return `false` once the walk is complete, or has failed (see `error()`).
+   */
+  bool next(String &element, String &value);
+
+  /** @return The reply that ended the walk early (an error, or a lost connection), or `nullptr` */
+  std::shared_ptr<RedisObject> error() const { return failure; }
+
+  /**
+   * Start the walk over, e.g. after an error. The options set are kept.
+   */
+  void reset();
+
+private:
+  bool advance();
+  void request();
+  static void onPage(Redis *redis, std::shared_ptr<RedisObject> reply, void *context);
+
+  Redis &redis;
+  RedisScanType type;
+  const char *key;
+  const char *match = nullptr;
+  const char *keyType = nullptr;
+  unsigned int count = 0;
+  bool prefetch = false;
+
+  String cursor = "0";
+  // the server has returned the last page (a cursor of 0)
+  bool complete = false;
+  bool inFlight = false;
+  std::shared_ptr<RedisObject> fetched;
+  std::shared_ptr<RedisObject> page;
+  size_t index = 0;
+  std::shared_ptr<RedisObject> failure;
+};
+
+#endif // REDIS_SCAN_H
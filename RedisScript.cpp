@@ -0,0 +1,127 @@
+#include "RedisScript.h"
+
+// SHA1 (FIPS 180-1) of `len` bytes at `data`, as 40 hex digits and a NUL into `hex`
+static void sha1Hex(const uint8_t *data, size_t len, char *hex)
+{
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block[64];
+  uint64_t bits = (uint64_t)len * 8;
+
+  // the message is followed by 0x80, zeros, and its length in bits, padded to a multiple of 64 bytes
+  size_t total = ((len + 8) / 64 + 1) * 64;
+  for (size_t offset = 0; offset < total; offset += 64)
+  {
+    for (size_t i = 0; i < 64; i++)
+    {
+      auto pos = offset + i;
+      if (pos < len)
+        block[i] = data[pos];
+      else if (pos == len)
+        block[i] = 0x80;
+      else if (pos >= total - 8)
+        block[i] = (uint8_t)(bits >> (8 * (total - 1 - pos)));
+      else
+        block[i] = 0;
+    }
+
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+    {
+      w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++)
+    {
+      auto x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = x << 1 | x >> 31;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++)
+    {
+      uint32_t f, k;
+      if (i < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      }
+      else
+      {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+
+      auto t = (a << 5 | a >> 27) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = b << 30 | b >> 2;
+      b = a;
+      a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  static const char digits[] = "0123456789abcdef";
+  for (int i = 0; i < 20; i++)
+  {
+    auto byte = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+    hex[i * 2] = digits[byte >> 4];
+    hex[i * 2 + 1] = digits[byte & 0xf];
+  }
+  hex[40] = '\0';
+}
+
+// The arguments of EVALSHA or FCALL: `name`, the number of keys, the keys, then the other arguments
+static ArgList callArgs(const char *name, const std::vector<String> &keys, const std::vector<String> &args)
+{
+  ArgList callArgs;
+  callArgs.reserve(2 + keys.size() + args.size());
+  callArgs.push_back(name);
+  callArgs.push_back(String((unsigned int)keys.size()));
+  callArgs.insert(callArgs.end(), keys.begin(), keys.end());
+  callArgs.insert(callArgs.end(), args.begin(), args.end());
+  return callArgs;
+}
+
+RedisScript::RedisScript(const char *body) : _body(body)
+{
+  sha1Hex((const uint8_t *)body, strlen(body), _sha);
+}
+
+bool RedisScript::load(Redis &redis)
+{
+  auto reply = RedisCommand::issue(*redis.reader, {"SCRIPT", "LOAD", _body});
+  return reply->type() == RedisObject::Type::BulkString && (String)*reply == _sha;
+}
+
+std::shared_ptr<RedisObject> RedisScript::run(Redis &redis, const std::vector<String> &keys, const std::vector<String> &args)
+{
+  auto evalArgs = callArgs(_sha, keys, args);
+  auto reply = RedisCommand::issue(*redis.reader, "EVALSHA", evalArgs);
+
+  // the server doesn't have the script (it never had, or has since restarted or flushed its scripts)
+  if (reply->type() == RedisObject::Type::Error && ((String)*reply).startsWith("NOSCRIPT") && load(redis))
+  {
+    reply = RedisCommand::issue(*redis.reader, "EVALSHA", evalArgs);
+  }
+  return reply;
+}
+
+std::shared_ptr<RedisObject> RedisFunction::run(Redis &redis, const std::vector<String> &keys, const std::vector<String> &args)
+{
+  return RedisCommand::issue(*redis.reader, _readOnly ? "FCALL_RO" : "FCALL", callArgs(_name, keys, args));
+}
@@ -0,0 +1,98 @@
+#ifndef REDIS_SCRIPT_H
+#define REDIS_SCRIPT_H
+
+#include "Redis.h"
+#include "RedisInternal.h"
+
+/** A Lua script run server-side with EVALSHA, so that compound operations (a rate limiter, a conditional update)
+ *  cost one round trip, and the script's body is sent only when the server doesn't already have it: its SHA1 is
+ *  computed here, once, and the body is loaded with SCRIPT LOAD only upon a NOSCRIPT error (e.g. after the server
+ *  restarts), the call then being retried.
+ *
+ *  Usage:
+ *  @code
+ *  // declared once, e.g. at file scope
+ *  RedisScript rateLimit(
+ *      "local n = redis.call('INCR', KEYS[1]) "
+ *      "if n == 1 then redis.call('EXPIRE', KEYS[1], ARGV[1]) end "
+ *      "return n");
+ *
+ *  int calls = rateLimit.run_typed<int>(redis, {"rate:sensor"}, {"60"});
+ *  @endcode
+ */
+class RedisScript
+{
+public:
+  /**
+   * @param body The script's source, which must outlive this (as a string literal does).
+   */
+  RedisScript(const char *body);
+
+  RedisScript(const RedisScript &) = delete;
+  RedisScript &operator=(const RedisScript &) = delete;
+
+  /**
+   * Run the script on the connection of `redis`.
+   * @param keys The keys the script accesses, as KEYS.
+   * @param args Its other arguments, as ARGV.
+   * @return The script's reply.
+   */
+  std::shared_ptr<RedisObject> run(Redis &redis, const std::vector<String> &keys = {},
+                                   const std::vector<String> &args = {});
+
+  /** As `run()`, with the reply converted as `RedisCommand::issue_typed()` would */
+  template <typename T>
+  T run_typed(Redis &redis, const std::vector<String> &keys = {}, const std::vector<String> &args = {})
+  {
+    return RedisCommand::convert_typed<T>(run(redis, keys, args));
+  }
+
+  /**
+   * Load the script now (e.g. in `setup()`), rather than upon its first run.
+   * @return `true` if the server has the script.
+   */
+  bool load(Redis &redis);
+
+  /** @return The SHA1 of the script's body, in hex, by which EVALSHA names it */
+  const char *sha() const { return _sha; }
+
+private:
+  const char *_body;
+  char _sha[41];
+};
+
+/** A Redis 7 function, run with FCALL through the same interface as a RedisScript.
+ *  Functions are loaded into the server separately (FUNCTION LOAD), persisting with its data.
+ *
+ *  Usage:
+ *  @code
+ *  RedisFunction setIfHigher("set_if_higher");
+ *  setIfHigher.run(redis, {"temp:max"}, {"23"});
+ *  @endcode
+ */
+class RedisFunction
+{
+public:
+  /**
+   * @param name The function's name, which must outlive this (as a string literal does).
+   * @param readOnly `true` to call it with FCALL_RO, so that it may run on a read-only replica.
+   */
+  RedisFunction(const char *name, bool readOnly = false) : _name(name), _readOnly(readOnly) {}
+
+  /** As `RedisScript::run()` */
+  std::shared_ptr<RedisObject> run(Redis &redis, const std::vector<String> &keys = {},
+                                   const std::vector<String> &args = {});
+
+  /** As `RedisScript::run_typed()` */
+  template <typename T>
+  T run_typed(Redis &redis, const std::vector<String> &keys = {}, const std::vector<String> &args = {})
+  {
+    return RedisCommand::convert_typed<T>(run(redis, keys, args));
+  }
+
+private:
+  const char *_name;
+  bool _readOnly;
+};
+
+#endif // REDIS_SCRIPT_H
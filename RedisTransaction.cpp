@@ -0,0 +1,203 @@
+#include "RedisTransaction.h"
+
+static const char queuedReply[] = "+QUEUED\r\n";
+
+static std::shared_ptr<RedisObject> lostConnection()
+{
+  return std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::Disconnected));
+}
+
+// Read the acknowledgement of a queued command. A "+QUEUED" is matched against the reader's buffer and consumed,
+// as it arrives, without allocating; anything else (the command refused, or a RESP3 push frame ahead of the
+// acknowledgement) is parsed as usual, into `reply`. As with RedisObject::parseType(), it times out only once
+// part of it has arrived, however long the server takes to begin answering.
+// @return `true` if the command was queued
+static bool skipQueued(RedisReader &reader, std::shared_ptr<RedisObject> &reply)
+{
+  const size_t len = sizeof(queuedReply) - 1;
+  size_t matched = 0;
+  auto lastProgress = millis();
+  while (matched < len)
+  {
+    if (!reader.poll())
+    {
+      if (!reader.connected())
+      {
+        reply = lostConnection();
+        return false;
+      }
+
+      if (matched && millis() - lastProgress >= reader.client().getTimeout())
+      {
+        reply = std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownError, "reply timed out"));
+        return false;
+      }
+
+      yield();
+      continue;
+    }
+
+    auto avail = reader.buffered() < len - matched ? reader.buffered() : len - matched;
+    if (memcmp(reader.peek(), queuedReply + matched, avail))
+    {
+      if (matched)
+      {
+        reply = std::shared_ptr<RedisObject>(new RedisInternalError(RedisInternalError::UnknownType, "expected QUEUED"));
+        return false;
+      }
+
+      reply = RedisObject::parseType(reader);
+      if (reply->type() == RedisObject::Type::SimpleString && (String)*reply == "QUEUED")
+      {
+        // after a push frame
+        return true;
+      }
+      return false;
+    }
+
+    reader.consume(avail);
+    matched += avail;
+    lastProgress = millis();
+  }
+  return true;
+}
+
+void RedisTransaction::startTransaction()
+{
+  if (executed)
+  {
+    outbound.bytes.clear();
+    count = 0;
+    replies.clear();
+    executed = false;
+  }
+
+  if (outbound.bytes.empty())
+  {
+    RedisEncoder(outbound).command({"MULTI"});
+  }
+}
+
+bool RedisTransaction::watch(const std::vector<String> &keys)
+{
+  auto rv = RedisCommand::issue(*redis.reader, "WATCH", keys);
+  watching = rv->type() == RedisObject::Type::SimpleString && (String)*rv == "OK";
+  return watching;
+}
+
+RedisTransaction::Slot RedisTransaction::queue(String command, ArgList args)
+{
+  startTransaction();
+  RedisEncoder(outbound).command(command, args);
+  return count++;
+}
+
+RedisTransaction::Slot RedisTransaction::queue(std::initializer_list<RedisArg> cmdAndArgs)
+{
+  startTransaction();
+  RedisEncoder(outbound).command(cmdAndArgs);
+  return count++;
+}
+
+RedisTransactionResult RedisTransaction::fail(std::shared_ptr<RedisObject> reason)
+{
+  for (auto &reply : replies)
+  {
+    if (!reply)
+    {
+      reply = reason;
+    }
+  }
+  return RedisTransactionFailed;
+}
+
+// The replies still due (acknowledgements, and EXEC's) can no longer be told apart from whatever follows them, once
+// one has timed out part-way or been garbled: the connection is closed rather than have the next command read one
+// of them as its own reply. (A RedisConnection restores it for the next command.)
+RedisTransactionResult RedisTransaction::abandon(std::shared_ptr<RedisObject> reason)
+{
+  redis.conn.stop();
+  redis.reader->reset();
+  return fail(reason);
+}
+
+RedisTransactionResult RedisTransaction::exec()
+{
+  redis.wait();
+  startTransaction();
+  executed = true;
+  // EXEC (or the connection's loss) ends any WATCH
+  watching = false;
+  replies.assign(count, nullptr);
+
+  auto &reader = *redis.reader;
+  if (!redis.conn.connected())
+  {
+    return fail(lostConnection());
+  }
+
+  RedisEncoder(outbound).command({"EXEC"});
+  redis.conn.write(outbound.bytes.data(), outbound.bytes.size());
+  outbound.bytes.clear();
+
+  // were MULTI refused, it would be as nested in another, which would still queue the commands
+  auto multiReply = RedisObject::parseType(reader);
+  if (multiReply->type() == RedisObject::Type::InternalError)
+  {
+    return abandon(multiReply);
+  }
+
+  // a command refused keeps its error as its reply; EXEC will then refuse the whole transaction
+  for (size_t i = 0; i < count; i++)
+  {
+    std::shared_ptr<RedisObject> refused;
+    if (!skipQueued(reader, refused))
+    {
+      replies[i] = refused;
+      if (refused->type() == RedisObject::Type::InternalError)
+      {
+        return abandon(refused);
+      }
+    }
+  }
+
+  auto execReply = RedisObject::parseType(reader);
+  auto execType = execReply->type();
+  if (execType == RedisObject::Type::Array && !((RedisArray *)execReply.get())->isNilReturn())
+  {
+    auto results = (RedisArray *)execReply.get();
+    for (size_t i = 0; i < count; i++)
+    {
+      replies[i] = results->at(i);
+    }
+    return RedisTransactionCommitted;
+  }
+
+  // a null array (a null under RESP3) in place of the replies: a watched key changed
+  if ((execType == RedisObject::Type::Array) ||
+      (execType == RedisObject::Type::BulkString && ((RedisBulkString *)execReply.get())->isNilReturn()))
+  {
+    return RedisTransactionAborted;
+  }
+
+  return execType == RedisObject::Type::InternalError ? abandon(execReply) : fail(execReply);
+}
+
+void RedisTransaction::discard()
+{
+  if (watching)
+  {
+    RedisCommand::issue(*redis.reader, {"UNWATCH"});
+    watching = false;
+  }
+
+  outbound.bytes.clear();
+  count = 0;
+  replies.clear();
+  executed = false;
+}
+
+std::shared_ptr<RedisObject> RedisTransaction::reply(Slot slot) const
+{
+  return slot < replies.size() ? replies[slot] : nullptr;
+}
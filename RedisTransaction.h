@@ -0,0 +1,118 @@
+#ifndef REDIS_TRANSACTION_H
+#define REDIS_TRANSACTION_H
+
+#include "Redis.h"
+#include "RedisInternal.h"
+
+/** The return value from `RedisTransaction::exec()` */
+typedef enum
+{
+  /// Every command was applied, atomically; each reply is available.
+  RedisTransactionCommitted = 0,
+  /// A watched key changed before EXEC, so no command was applied: read the keys again and retry.
+  RedisTransactionAborted,
+  /// No command was applied, because one was refused (e.g. a wrong number of arguments; see its reply) or the
+  /// connection was lost.
+  RedisTransactionFailed,
+} RedisTransactionResult;
+
+/** Applies several commands atomically with MULTI/EXEC, in a single round trip: MULTI, the commands and EXEC are
+ *  written in one flush, then each command's "+QUEUED" acknowledgement is skipped over without being parsed into
+ *  an object, and the replies in EXEC's array are handed out per command.
+ *
+ *  Usage, with WATCH for optimistic concurrency:
+ *  @code
+ *  RedisTransaction tx(redis);
+ *  do
+ *  {
+ *    tx.watch({"lease"});
+ *    if (redis.get("lease") != owner) break;
+ *    tx.queue({"HSET", "device", "state", "on"});
+ *    auto event = tx.queue({"XADD", "events", "*", "state", "on"});
+ *    tx.queue({"EXPIRE", "lease", "30"});
+ *  } while (tx.exec() == RedisTransactionAborted);
+ *  @endcode
+ *
+ *  A transaction may be reused: calling `watch()` or `queue()` after `exec()` starts a new one.
+ */
+class RedisTransaction
+{
+public:
+  /** An index into the reply slots of an executed transaction, as returned by `queue()` */
+  typedef size_t Slot;
+
+  /**
+   * Create a transaction over the connection of `redis`.
+   * @param redis The Redis instance whose connection will carry the transaction. Must outlive it.
+   */
+  RedisTransaction(Redis &redis) : redis(redis) {}
+
+  ~RedisTransaction() {}
+  RedisTransaction(const RedisTransaction &) = delete;
+  RedisTransaction &operator=(const RedisTransaction &) = delete;
+
+  /**
+   * WATCH `keys` now, so that `exec()` applies nothing should any of them change before it does.
+   * @return `true` if the server is watching them.
+   */
+  bool watch(const std::vector<String> &keys);
+
+  /**
+   * Queue `command` with arguments `args`. Nothing is sent until `exec()` is called.
+   * @return The slot from which this command's reply may be retrieved after `exec()`.
+   */
+  Slot queue(String command, ArgList args = ArgList());
+
+  /**
+   * Queue a command given as its name followed by its arguments, e.g. `queue({"HSET", key, field, value})`.
+   * The arguments are encoded immediately, so they need not outlive this call.
+   * @return The slot from which this command's reply may be retrieved after `exec()`.
+   */
+  Slot queue(std::initializer_list<RedisArg> cmdAndArgs);
+
+  /**
+   * Write MULTI, every queued command and EXEC in a single flush, then read the outcome.
+   */
+  RedisTransactionResult exec();
+
+  /** The number of commands queued in the current transaction */
+  size_t size() const { return count; }
+
+  /**
+   * Discard any queued commands and replies, and UNWATCH any keys watched.
+   */
+  void discard();
+
+  /**
+   * The reply to the command queued at `slot`: once committed, its result (which may itself be an error, as from a
+   * command applied to a key of the wrong type); if failed, the reason.
+   * @return The reply, or `nullptr` if `slot` is out of range or the transaction was not executed or was aborted.
+   */
+  std::shared_ptr<RedisObject> reply(Slot slot) const;
+
+  /**
+   * The reply to the command queued at `slot`, converted as `RedisCommand::issue_typed()` would.
+   */
+  template <typename T>
+  T reply_typed(Slot slot) const { return RedisCommand::convert_typed<T>(reply(slot)); }
+
+  /**
+   * The reply to the command queued at `slot`, converted as `RedisCommand::convert_result()` would.
+   */
+  template <typename T>
+  RedisResult<T> reply_result(Slot slot) const { return RedisCommand::convert_result<T>(reply(slot)); }
+
+private:
+  void startTransaction();
+  RedisTransactionResult fail(std::shared_ptr<RedisObject> reason);
+  RedisTransactionResult abandon(std::shared_ptr<RedisObject> reason);
+
+  Redis &redis;
+  RedisOutbound outbound;
+  size_t count = 0;
+  bool watching = false;
+  bool executed = false;
+  std::vector<std::shared_ptr<RedisObject>> replies;
+};
+
+#endif // REDIS_TRANSACTION_H
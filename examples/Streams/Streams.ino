@@ -46,6 +46,18 @@ void print_vector(std::vector<String> output)
   }
 }
 
+void print_entry(Redis *redis, const RedisStreamEntry &entry)
+{
+  Serial.print(entry.id());
+  for (size_t i = 0; i < entry.size(); i++) {
+    Serial.print(" ");
+    Serial.print(entry.field(i));
+    Serial.print("=");
+    Serial.print(entry.value(i));
+  }
+  Serial.println();
+}
+
 void test_write(Redis *redis)
 {
   char charBuf[60];
@@ -102,6 +114,17 @@ void test_write(Redis *redis)
   Serial.println(charBuf);
   print_vector(redis->xrange(STREAMS_KEY, "-", "+", 0));
 
+  // XRANGE, keeping each entry's ID and fields together
+  Serial.println(charBuf);
+  auto entries = redis->xrange_entries(STREAMS_KEY, "-", "+", 0);
+  for (size_t i = 0; i < entries.size(); i++) {
+    print_entry(redis, entries[i]);
+  }
+
+  // XRANGE, handling each entry as it arrives rather than holding the whole reply
+  Serial.println(charBuf);
+  redis->xrange_entries(STREAMS_KEY, "-", "+", 0, print_entry);
+
   // XREVRANGE
   sprintf(charBuf, "XREVRANGE %s + -", STREAMS_KEY);
   Serial.println(charBuf);
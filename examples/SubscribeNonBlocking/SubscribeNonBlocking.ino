@@ -1,4 +1,5 @@
 #include <Redis.h>
+#include <RedisConnection.h>
 
 // this sketch will build for the ESP8266 or ESP32 platform
 #ifdef HAL_ESP32_HAL_H_ // ESP32
@@ -36,22 +37,38 @@ void setup()
     Serial.print("IP Address: ");
     Serial.println(WiFi.localIP());
 
-    auto backoffCounter = -1;
-    auto resetBackoffCounter = [&]() { backoffCounter = 0; };
-
-    resetBackoffCounter();
-    while (subscriberLoop(resetBackoffCounter))
+    // reconnects, re-authenticates and re-subscribes by itself whenever the connection is lost
+    static WiFiClient redisConn;
+    static RedisConnection connection(redisConn, REDIS_ADDR, REDIS_PORT);
+    connection.setPassword(REDIS_PASSWORD);
+    connection.setBackoff(1000, MAX_BACKOFF);
+    while (!connection.connect())
     {
-        auto curDelay = min((1000 * (int)pow(2, backoffCounter)), MAX_BACKOFF);
-
-        if (curDelay != MAX_BACKOFF)
+        // no use trying again with the same password
+        if (connection.lastFailure() == RedisAuthFailure)
         {
-            ++backoffCounter;
+            Serial.println("The Redis server refused the password!");
+            return;
         }
 
-        Serial.printf("Waiting %ds to reconnect...\n", curDelay / 1000);
-        delay(curDelay);
+        Serial.println("Failed to connect to the Redis server! Retrying...");
+        delay(1000);
     }
+    Serial.println("Connected to the Redis server!");
+
+    Redis &redis = connection.redis();
+
+    // subscribed to with a single command once subscribing starts
+    redis.subscribe({"foo", "bar"});
+
+    redis.psubscribe("ctrl-*");
+
+    // sleep between messages, for no more than 100ms at a time, rather than busy-polling the connection
+    redis.setSubscriberIdle(RedisIdleBackoff, 100);
+
+    Serial.println("Listening...");
+    auto subRv = redis.startSubscribingNonBlocking(msgCallback, loop, errorCallback);
+    Serial.printf("Stopped subscribing (%d)\n", subRv);
 
     Serial.printf("Done!\n");
 }
@@ -89,43 +106,6 @@ void errorCallback(Redis *redisInst, RedisMessageError err) {
   Serial.printf("Subscription error! '%d'\n", err);
 }
 
-// returning 'true' indicates the failure was retryable; false is fatal
-bool subscriberLoop(std::function<void(void)> resetBackoffCounter)
-{
-  WiFiClient redisConn;
-  if (!redisConn.connect(REDIS_ADDR, REDIS_PORT))
-  {
-    Serial.println("Failed to connect to the Redis server!");
-    return true;
-  }
-
-  Redis redis(redisConn);
-  auto connRet = redis.authenticate(REDIS_PASSWORD);
-  if (connRet == RedisSuccess)
-  {
-    Serial.println("Connected to the Redis server!");
-  }
-  else
-  {
-    Serial.printf("Failed to authenticate to the Redis server! Errno: %d\n", (int)connRet);
-    return false;
-  }
-
-  redis.subscribe("foo");
-  redis.subscribe("bar");
-
-  redis.psubscribe("ctrl-*");
-
-  Serial.println("Listening...");
-  resetBackoffCounter();
-
-  auto subRv = redis.startSubscribingNonBlocking(msgCallback, loop, errorCallback);
-
-  redisConn.stop();
-  Serial.printf("Connection closed! (%d)\n", subRv);
-  return subRv == RedisSubscribeServerDisconnected; // server disconnect is retryable, everything else is fatal
-};
-
 void loop() 
 {
   delay(1000);
@@ -1,5 +1,6 @@
 #include <Redis.h>
 #include <RedisInternal.h>
+#include <RedisScan.h>
 
 #include <AUnitVerbose.h>
 
@@ -70,15 +71,16 @@ protected:
 
     void teardown() override
     {
-        auto keys = RedisCommand("KEYS", ArgList{String(gKeyPrefix + "*").c_str()}).issue(*client);
-
-        if (keys->type() == RedisObject::Type::Array)
+        auto pattern = String(gKeyPrefix + "*");
+        RedisScan scan(*r);
+        scan.setMatch(pattern.c_str());
+        scan.setCount(100);
+        scan.setPrefetch(true);
+
+        String key;
+        while (scan.next(key))
         {
-            std::vector<String> as_strings = *dynamic_cast<RedisArray *>(keys.get());
-            for (const auto &key : as_strings)
-            {
-                r->del(key.c_str());
-            }
+            r->del(key.c_str());
         }
 
         aunit::TestOnce::teardown();
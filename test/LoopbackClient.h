@@ -0,0 +1,186 @@
+#include <Arduino.h>
+#include <Client.h>
+
+#include <string>
+
+// An in-memory Client for deterministic tests and benchmarks, without a server or network noise.
+//
+// Bytes given to `script()` are what the "server" sends, and are read back through a cursor
+// (never by copying what remains). Reads may be split into chunks of at most `setChunkSize()` bytes,
+// each becoming readable only `setLatency()` microseconds after the previous one was read or a
+// command was written, to simulate the fragmentation and delays of a Wi-Fi link. Everything
+// written is captured for inspection by `written()`. `drop()` simulates the link being lost.
+class LoopbackClient : public Client
+{
+public:
+    LoopbackClient(std::string replies = std::string()) : toSend(replies) {}
+
+    // Queue more bytes from the "server"
+    void script(const std::string &moreReplies)
+    {
+        // drop what has been read once that is most of the buffer, keeping appends amortized O(1)
+        if (pos > toSend.size() / 2)
+        {
+            toSend.erase(0, pos);
+            pos = 0;
+        }
+        toSend += moreReplies;
+    }
+
+    // Start over from the beginning of the scripted bytes once they are exhausted, forever
+    void setRepeat(bool repeat) { this->repeat = repeat; }
+
+    // Make at most `chunk` bytes readable at a time; 0 for no limit
+    void setChunkSize(size_t chunk) { chunkSize = chunk; }
+
+    // Make each chunk readable only `us` microseconds after the previous one was read or after a write
+    void setLatency(unsigned long us) { latency = us; }
+
+    // Lose the connection, with anything unread, until the next connect(); which fails while `refuse` is set,
+    // returning `result` (0, or a negative code as EthernetClient's does)
+    void drop()
+    {
+        pos = toSend.size();
+        isConnected = false;
+    }
+    void setRefuseConnections(bool refuse, int result = 0)
+    {
+        refuseConnections = refuse;
+        refuseResult = result;
+    }
+    size_t connects() const { return connectCalls; }
+
+    // Everything written so far, and the number of write calls it arrived in
+    const std::string &written() const { return sent; }
+    size_t writeCalls() const { return writes; }
+    void clearWritten()
+    {
+        sent.clear();
+        writes = 0;
+    }
+
+    int connect(IPAddress ip, uint16_t port)
+    {
+        (void)ip;
+        (void)port;
+        return reconnect();
+    }
+
+    int connect(const char *host, uint16_t port)
+    {
+        (void)host;
+        (void)port;
+        return reconnect();
+    }
+
+    size_t write(uint8_t val) { return write(&val, 1); }
+
+    size_t write(const uint8_t *buf, size_t size)
+    {
+        if (!isConnected)
+        {
+            return 0;
+        }
+
+        sent.append((const char *)buf, size);
+        writes++;
+        delayChunk();
+        return size;
+    }
+
+    int available()
+    {
+        if (!isConnected)
+        {
+            return 0;
+        }
+
+        if (repeat && pos == toSend.size())
+        {
+            pos = 0;
+        }
+
+        if (chunkLeft == 0)
+        {
+            if (latency && micros() - chunkStart < latency)
+            {
+                return 0;
+            }
+            chunkLeft = chunkSize ? chunkSize : (size_t)-1;
+        }
+
+        auto left = toSend.size() - pos;
+        return left < chunkLeft ? left : chunkLeft;
+    }
+
+    int read()
+    {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+
+    int read(uint8_t *buf, size_t size)
+    {
+        size_t avail = available();
+        if (size > avail)
+        {
+            size = avail;
+        }
+
+        memcpy(buf, toSend.data() + pos, size);
+        pos += size;
+        if (chunkSize)
+        {
+            chunkLeft -= size;
+            if (!chunkLeft)
+            {
+                delayChunk();
+            }
+        }
+        return size;
+    }
+
+    int peek()
+    {
+        return available() ? (uint8_t)toSend[pos] : -1;
+    }
+
+    void flush() {}
+
+    void stop() { isConnected = false; }
+
+    uint8_t connected() { return isConnected; }
+
+    virtual operator bool() { return isConnected; }
+
+private:
+    int reconnect()
+    {
+        connectCalls++;
+        isConnected = !refuseConnections;
+        return isConnected ? 1 : refuseResult;
+    }
+
+    void delayChunk()
+    {
+        chunkLeft = 0;
+        chunkStart = micros();
+    }
+
+    std::string toSend;
+    size_t pos = 0;
+    bool repeat = false;
+
+    size_t chunkSize = 0;
+    size_t chunkLeft = 0;
+    unsigned long latency = 0;
+    unsigned long chunkStart = 0;
+
+    std::string sent;
+    size_t writes = 0;
+
+    bool isConnected = true;
+    bool refuseConnections = false;
+    int refuseResult = 0;
+    size_t connectCalls = 0;
+};
@@ -7,10 +7,19 @@ class TestDirectClient : public Client
 {
 private:
     std::string toSend;
+    size_t pos = 0;
 
 public:
     TestDirectClient(std::string RESPtoSend) : toSend(RESPtoSend) {}
 
+    // simulates more of a reply arriving after some has already been read
+    void append(std::string moreRESP)
+    {
+        toSend.erase(0, pos);
+        pos = 0;
+        toSend += moreRESP;
+    }
+
     int connect(IPAddress ip, uint16_t port)
     {
         (void)ip;
@@ -38,30 +47,28 @@ public:
         return 0;
     }
 
-    int available() { return toSend.size(); }
+    int available() { return toSend.size() - pos; }
 
     int read()
     {
-        auto retval = toSend.at(0);
-        toSend = toSend.substr(1, std::string::npos);
-        return retval;
+        return available() ? toSend[pos++] : -1;
     }
 
     int read(uint8_t *buf, size_t size)
     {
-        if (size > toSend.size())
+        if (size > (size_t)available())
         {
-            size = toSend.size();
+            size = available();
         }
 
-        ::memcpy(buf, toSend.c_str(), size);
-        toSend = toSend.substr(size, std::string::npos);
+        ::memcpy(buf, toSend.data() + pos, size);
+        pos += size;
         return size;
     }
 
     int peek()
     {
-        return toSend.size() ? toSend.at(0) : -1;
+        return available() ? toSend[pos] : -1;
     }
 
     void flush() {}
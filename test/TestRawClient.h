@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -72,9 +73,17 @@ public:
     return ::send(sock_fd, buf, size, 0);
   }
 
-  // RedisObject::parseTypeNonBlocking() calls this but does not
-  // use the return value, so *for now* this is OK...
-  int available() { return 1; }
+  // the number of bytes that can be read without blocking, so that RedisReader
+  // fills its buffer with one recv() rather than a byte at a time
+  int available()
+  {
+    int pending = 0;
+    if (sock_fd < 0 || ::ioctl(sock_fd, FIONREAD, &pending) < 0)
+    {
+      return 0;
+    }
+    return pending;
+  }
 
   int read()
   {
@@ -93,18 +102,36 @@ public:
     return ::recv(sock_fd, buf, size, 0);
   }
 
-  int peek() { return 0; }
+  int peek()
+  {
+    uint8_t buf;
+
+    if (::recv(sock_fd, &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT) > 0)
+    {
+      return buf;
+    }
+
+    return -1;
+  }
 
   void flush() {}
 
   void stop()
   {
     ::close(sock_fd);
+    sock_fd = -1;
   }
 
+  // with nothing to read, a peeked end-of-stream means the server closed the connection
   uint8_t connected()
   {
-    return operator bool();
+    if (!operator bool())
+    {
+      return 0;
+    }
+
+    uint8_t buf;
+    return available() || ::recv(sock_fd, &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT) != 0;
   }
 
   virtual operator bool()
@@ -0,0 +1,124 @@
+// Timing, allocation accounting and result reporting for bench.ino.
+// Native (EpoxyDuino on Linux) only: relies on std::chrono and, for allocation counts, glibc.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fnmatch.h>
+#include <vector>
+
+// Every heap allocation made by the process, including those made by String and operator new
+struct AllocStats
+{
+  unsigned long count;
+  unsigned long bytes;
+};
+
+static AllocStats gAllocs = {0, 0};
+
+#if defined(__GLIBC__)
+#define BENCH_COUNTS_ALLOCS 1
+
+extern "C"
+{
+  void *__libc_malloc(size_t);
+  void *__libc_calloc(size_t, size_t);
+  void *__libc_realloc(void *, size_t);
+
+  void *malloc(size_t size)
+  {
+    gAllocs.count++;
+    gAllocs.bytes += size;
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t n, size_t size)
+  {
+    gAllocs.count++;
+    gAllocs.bytes += n * size;
+    return __libc_calloc(n, size);
+  }
+
+  void *realloc(void *ptr, size_t size)
+  {
+    gAllocs.count++;
+    gAllocs.bytes += size;
+    return __libc_realloc(ptr, size);
+  }
+}
+#else
+#define BENCH_COUNTS_ALLOCS 0
+#endif
+
+// Selects which benchmarks run: an fnmatch() pattern over "<mode>/<name>" read from BENCH_FILTER
+static bool benchSelected(const char *mode, const char *name)
+{
+  const char *filter = std::getenv("BENCH_FILTER");
+  if (!filter)
+  {
+    return true;
+  }
+
+  String full = String(mode) + "/" + name;
+  return fnmatch(filter, full.c_str(), 0) == 0;
+}
+
+// Times `iterations` calls of `op` individually, then prints one JSON object per line:
+//   {"mode":..., "name":..., "iterations":..., "ops_per_sec":..., "p50_ns":..., "p99_ns":...,
+//    "allocs_per_op":..., "bytes_per_op":..., "mb_per_sec":...}
+// `payload` is the number of bytes each op parses or encodes, if any, for "mb_per_sec".
+// Allocation figures are -1 where they cannot be counted.
+template <typename Op>
+static void bench(const char *mode, const char *name, unsigned long iterations, size_t payload, Op op)
+{
+  if (!benchSelected(mode, name))
+  {
+    return;
+  }
+
+  const char *override = std::getenv("BENCH_ITERATIONS");
+  if (override)
+  {
+    // anything but a positive count (0, a negative or a non-numeric value) keeps the default
+    char *end = nullptr;
+    auto requested = std::strtol(override, &end, 10);
+    if (end != override && !*end && requested >= 1)
+    {
+      iterations = (unsigned long)requested;
+    }
+  }
+
+  // warm up: fill caches and any buffers that are allocated once and then reused
+  for (unsigned long i = 0; i < iterations / 10 + 1; i++)
+  {
+    op();
+  }
+
+  std::vector<unsigned long> samples(iterations);
+  auto allocsBefore = gAllocs;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++)
+  {
+    auto opStart = std::chrono::steady_clock::now();
+    op();
+    samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - opStart).count();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto allocs = gAllocs.count - allocsBefore.count;
+  auto bytes = gAllocs.bytes - allocsBefore.bytes;
+
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&](double p)
+  { return samples[std::min(iterations - 1, (unsigned long)(p * iterations))]; };
+
+  printf("{\"mode\":\"%s\",\"name\":\"%s\",\"iterations\":%lu,\"ops_per_sec\":%.1f,\"p50_ns\":%lu,\"p99_ns\":%lu,"
+         "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f,\"mb_per_sec\":%.2f}\n",
+         mode, name, iterations, iterations / elapsed, percentile(0.50), percentile(0.99),
+         BENCH_COUNTS_ALLOCS ? (double)allocs / iterations : -1.0,
+         BENCH_COUNTS_ALLOCS ? (double)bytes / iterations : -1.0,
+         payload ? (payload * iterations) / elapsed / (1024 * 1024) : 0.0);
+  fflush(stdout);
+}
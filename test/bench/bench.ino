@@ -0,0 +1,285 @@
+// Performance benchmarks: RESP parse and encode throughput, and per-command throughput and latency,
+// both against an in-memory LoopbackClient replaying canned replies (isolating the library's own cost) and, when one is
+// reachable, a live Redis server (at the same ARDUINO_REDIS_TEST_* location as the integration tests).
+//
+// Results are printed one JSON object per line; see BenchHarness.h. Set BENCH_FILTER to an fnmatch()
+// pattern over "<mode>/<name>" (e.g. "replay/parse_*") to run a subset, and BENCH_ITERATIONS to
+// override every benchmark's iteration count.
+
+#include <Arduino.h>
+#include <Client.h>
+
+#include <Redis.h>
+#include <RedisInternal.h>
+#include <RedisTransaction.h>
+
+#include <functional>
+#include <string>
+
+#include "BenchHarness.h"
+#include "../LoopbackClient.h"
+#include "../TestRawClient.h"
+
+const String gKeyPrefix = String("__arduino_redis__bench");
+
+// Discards everything written to it
+class NullPrint : public Print
+{
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+static std::string bulk(const std::string &s)
+{
+  return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+}
+
+static std::string bulkArray(int count, size_t elementSize)
+{
+  std::string reply = "*" + std::to_string(count) + "\r\n";
+  for (int i = 0; i < count; i++)
+  {
+    reply += bulk(std::string(elementSize, 'a' + i % 26));
+  }
+  return reply;
+}
+
+// `depth` levels of arrays of `width` elements, with integers at the leaves
+static std::string nestedArray(int depth, int width)
+{
+  if (!depth)
+  {
+    return ":42\r\n";
+  }
+
+  std::string reply = "*" + std::to_string(width) + "\r\n";
+  for (int i = 0; i < width; i++)
+  {
+    reply += nestedArray(depth - 1, width);
+  }
+  return reply;
+}
+
+// An XRANGE reply: an array of [id, [field, value, field, value]] entries
+static std::string xrangeReply(int entries)
+{
+  std::string reply = "*" + std::to_string(entries) + "\r\n";
+  for (int i = 0; i < entries; i++)
+  {
+    reply += "*2\r\n" + bulk(std::to_string(1700000000000 + i) + "-0");
+    reply += "*4\r\n" + bulk("temp") + bulk(std::to_string(20 + i % 10)) + bulk("hum") + bulk(std::to_string(40 + i % 30));
+  }
+  return reply;
+}
+
+// Enough iterations to parse or encode roughly 8 MB in all, within sensible bounds
+static unsigned long iterationsFor(size_t payload)
+{
+  unsigned long n = (8 * 1024 * 1024) / (payload ? payload : 1);
+  return n < 200 ? 200 : n > 200000 ? 200000 : n;
+}
+
+// `chunk`, if given, splits the reply into reads of at most that many bytes, as a Wi-Fi link would
+static void benchParse(const char *name, const std::string &reply, bool arena = false, size_t chunk = 0)
+{
+  LoopbackClient client(reply);
+  client.setRepeat(true);
+  client.setChunkSize(chunk);
+  RedisReader reader(client);
+  reader.parser().setArena(arena);
+
+  bench("replay", name, iterationsFor(reply.size()), reply.size(), [&]()
+        { RedisObject::parseType(reader); });
+}
+
+static void benchParsing()
+{
+  benchParse("parse_simple_string", "+OK\r\n");
+  benchParse("parse_integer", ":1234567\r\n");
+  benchParse("parse_bulk_32", bulk(std::string(32, 'x')));
+  benchParse("parse_bulk_4k", bulk(std::string(4096, 'x')));
+  benchParse("parse_array_100x8", bulkArray(100, 8));
+  benchParse("parse_nested_10x10x10", nestedArray(3, 10));
+  benchParse("parse_xrange_100", xrangeReply(100));
+  benchParse("parse_xrange_1000", xrangeReply(1000));
+  benchParse("parse_xrange_1000_arena", xrangeReply(1000), true);
+  benchParse("parse_xrange_1000_chunk_64", xrangeReply(1000), false, 64);
+  benchParse("parse_bulk_4k_chunk_64", bulk(std::string(4096, 'x')), false, 64);
+}
+
+static void benchEncoding()
+{
+  NullPrint sink;
+  String value1k(std::string(1024, 'v').c_str());
+  ArgList hsetArgs{"bench:hash"};
+  for (int i = 0; i < 16; i++)
+  {
+    hsetArgs.push_back(String("field") + i);
+    hsetArgs.push_back(String(i * 1000));
+  }
+
+  bench("replay", "encode_set_small", iterationsFor(40), 40, [&]()
+        { RedisEncoder(sink).command({"SET", "bench:key", "value"}); });
+  bench("replay", "encode_set_1k", iterationsFor(1060), 1060, [&]()
+        { RedisEncoder(sink).command({"SET", "bench:key", value1k}); });
+  bench("replay", "encode_hset_16_fields", iterationsFor(400), 400, [&]()
+        { RedisEncoder(sink).command("HSET", hsetArgs); });
+  bench("replay", "encode_xadd_2_fields", iterationsFor(80), 80, [&]()
+        { RedisEncoder(sink).command({"XADD", "bench:stream", "*", "temp", 21, "hum", 40}); });
+}
+
+// The same command mix is run against the replay client and a live server;
+// `only`, if given, restricts it to the one named command
+static void benchCommands(const char *mode, Redis &redis, const char *only = nullptr)
+{
+  String key = gKeyPrefix + ".string";
+  String hash = gKeyPrefix + ".hash";
+  String stream = gKeyPrefix + ".stream";
+  String list = gKeyPrefix + ".list";
+
+  auto run = [&](const char *name, unsigned long iterations, std::function<void()> op)
+  {
+    if (!only || !strcmp(only, name))
+    {
+      bench(mode, name, iterations, 0, op);
+    }
+  };
+
+  run("set", 20000, [&]()
+      { redis.set(key.c_str(), "value"); });
+  run("get", 20000, [&]()
+      { redis.get(key.c_str()); });
+  run("get_async", 20000, [&]()
+      {
+        redis.getAsync(key.c_str(), nullptr);
+        while (redis.pending())
+        {
+          redis.poll();
+        } });
+  run("hset", 20000, [&]()
+      { redis.hset(hash.c_str(), "field", "value"); });
+  run("xadd", 20000, [&]()
+      { redis.xadd(stream.c_str(), "*", "temp", "21"); });
+  run("lrange_100", 5000, [&]()
+      { redis.lrange(list.c_str(), 0, 99); });
+}
+
+static void benchReplayCommands()
+{
+  // each client replays the reply its one command expects
+  struct
+  {
+    const char *name;
+    std::string reply;
+  } canned[] = {
+      {"set", "+OK\r\n"},
+      {"get", bulk("value")},
+      {"get_async", bulk("value")},
+      {"hset", ":0\r\n"},
+      {"xadd", bulk("1700000000000-0")},
+      {"lrange_100", bulkArray(100, 8)},
+  };
+
+  for (auto &c : canned)
+  {
+    LoopbackClient client(c.reply);
+    client.setRepeat(true);
+    Redis redis(client);
+    benchCommands("replay", redis, c.name);
+  }
+}
+
+// A transaction of three commands, its acknowledgements skipped without being parsed into objects
+static void benchTransaction()
+{
+  LoopbackClient client("+OK\r\n+QUEUED\r\n+QUEUED\r\n+QUEUED\r\n*3\r\n:1\r\n$3\r\n1-0\r\n:1\r\n");
+  client.setRepeat(true);
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  bench("replay", "transaction_3", 20000, 0, [&]()
+        {
+          tx.queue({"HSET", "device", "state", "on"});
+          tx.queue({"XADD", "events", "*", "state", "on"});
+          tx.queue({"EXPIRE", "lease", 30});
+          tx.exec(); });
+}
+
+static size_t gMessageBytes = 0;
+
+// Each op feeds one 64-byte message to a subscribed connection, then polls it through to the callback
+static void benchSubscribe(const char *name, bool view, bool arena)
+{
+  const std::string message = "*3\r\n" + bulk("message") + bulk("telemetry") + bulk(std::string(64, 't'));
+
+  LoopbackClient client;
+  Redis redis(client);
+  redis.setReplyArena(arena);
+  if (view)
+  {
+    redis.beginSubscribing([](Redis *, const RedisMessage &msg)
+                           { gMessageBytes += msg.messageLength; });
+  }
+  else
+  {
+    redis.beginSubscribing([](Redis *, String, String message)
+                           { gMessageBytes += message.length(); });
+  }
+
+  bench("replay", name, 200000, message.size(), [&]()
+        {
+          client.script(message);
+          redis.pollSubscriptions(); });
+}
+
+static void benchSubscribing()
+{
+  benchSubscribe("subscribe_message_string", false, false);
+  benchSubscribe("subscribe_message_view", true, false);
+  benchSubscribe("subscribe_message_view_arena", true, true);
+}
+
+static void benchServerCommands()
+{
+  const char *host = std::getenv("ARDUINO_REDIS_TEST_HOST");
+  const char *port = std::getenv("ARDUINO_REDIS_TEST_PORT");
+  const char *auth = std::getenv("ARDUINO_REDIS_TEST_AUTH");
+
+  TestRawClient client;
+  if (!client.connect(host ? host : "localhost", port ? std::atoi(port) : 6379))
+  {
+    fprintf(stderr, "no Redis server reachable: skipping server benchmarks\n");
+    return;
+  }
+
+  Redis redis(client);
+  if (auth && redis.authenticate(auth) != RedisSuccess)
+  {
+    fprintf(stderr, "authentication failed: skipping server benchmarks\n");
+    return;
+  }
+
+  String list = gKeyPrefix + ".list";
+  for (int i = 0; i < 100; i++)
+  {
+    redis.rpush(list.c_str(), "element");
+  }
+
+  benchCommands("server", redis);
+  redis.del({gKeyPrefix + ".string", gKeyPrefix + ".hash", gKeyPrefix + ".stream", list});
+  client.stop();
+}
+
+void setup()
+{
+  benchParsing();
+  benchEncoding();
+  benchReplayCommands();
+  benchTransaction();
+  benchSubscribing();
+  benchServerCommands();
+  exit(0);
+}
+
+void loop() {}
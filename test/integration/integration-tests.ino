@@ -3,10 +3,17 @@
 
 #include <Redis.h>
 #include <RedisInternal.h>
+#include <RedisPipeline.h>
+#include <RedisClientCache.h>
+#include <RedisConnection.h>
+#include <RedisTransaction.h>
+#include <RedisScript.h>
+#include <RedisScan.h>
 
 #include <AUnitVerbose.h>
 
 #include <map>
+#include <set>
 
 #include "../ArduinoRedisTestBase.h"
 #include "../IntegrationTestBase.h"
@@ -328,6 +335,92 @@ testF(IntegrationTests, op_vec_string_issue67)
   assertEqual(list[2], "3");
 }
 
+class SummingVisitor : public RedisVisitor
+{
+public:
+  void element(RedisObject::Type type, const uint8_t *data, size_t length, size_t depth) override
+  {
+    if (type == RedisObject::Type::BulkString && depth == 1)
+    {
+      String value;
+      value.concat((const char *)data, length);
+      sum += value.toInt();
+      count++;
+    }
+  }
+
+  int sum = 0;
+  int count = 0;
+};
+
+testF(IntegrationTests, lrange_visitor)
+{
+  defineKey("lrange_visitor");
+
+  for (int i = 1; i <= 100; i++)
+  {
+    assertEqual(r->rpush(key, String(i).c_str()), i);
+  }
+
+  SummingVisitor visitor;
+  assertEqual(r->lrange(key, 0, -1, visitor), 100);
+  assertEqual(visitor.count, 100);
+  assertEqual(visitor.sum, 5050);
+}
+
+testF(IntegrationTests, setget_binary)
+{
+  defineKey("setget_binary");
+  const uint8_t value[] = {'a', 0x00, 'b', '\r', '\n', 0xff};
+
+  assertEqual(r->set(key, value, sizeof(value)), true);
+
+  uint8_t buf[sizeof(value)];
+  assertEqual(r->get(key, buf, sizeof(buf)), (int)sizeof(value));
+  assertEqual(memcmp(buf, value, sizeof(value)), 0);
+
+  uint8_t small[2];
+  assertEqual(r->get(key, small, sizeof(small)), (int)sizeof(value));
+  assertEqual(memcmp(small, value, sizeof(small)), 0);
+
+  assertEqual(r->get(prefixKeyCStr("setget_binary_nil"), buf, sizeof(buf)), -1);
+}
+
+testF(IntegrationTests, mset_mget)
+{
+  String a = prefixKeyCStr("mset_mget_a");
+  String b = prefixKeyCStr("mset_mget_b");
+  String missing = prefixKeyCStr("mset_mget_missing");
+
+  assertEqual(r->mset({{a, "1"}, {b, "2"}}), true);
+
+  auto values = r->mget({a, missing, b});
+  assertEqual((int)values.size(), 3);
+  assertEqual(values[0], "1");
+  assertTrue(Redis::isNilReturn(values[1]));
+  assertEqual(values[2], "2");
+
+  assertEqual(r->exists({a, missing, b}), 2);
+  assertEqual(r->del({a, missing}), 1);
+  assertEqual(r->unlink({b}), 1);
+  assertEqual(r->exists({a, b}), 0);
+}
+
+testF(IntegrationTests, hset_multi_hmget)
+{
+  defineKey("hset_multi_hmget");
+
+  assertEqual(r->hset(key, {{"f1", "1"}, {"f2", "2"}}), 2);
+  assertEqual(r->hset(key, {{"f2", "two"}, {"f3", "3"}}), 1);
+
+  auto values = r->hmget(key, {"f1", "nope", "f2", "f3"});
+  assertEqual((int)values.size(), 4);
+  assertEqual(values[0], "1");
+  assertTrue(Redis::isNilReturn(values[1]));
+  assertEqual(values[2], "two");
+  assertEqual(values[3], "3");
+}
+
 testF(IntegrationTests, del)
 {
   defineKey("del");
@@ -402,6 +495,41 @@ testF(IntegrationTests, xrange)
   assertEqual(result[5], "Allison");
 }
 
+testF(IntegrationTests, xrange_entries)
+{
+  auto id1 = r->xadd("mystream", "*", "name", "Serena");
+  auto id2 = r->xadd("mystream", "*", "name", "Allison");
+  auto entries = r->xrange_entries("mystream", String(id1).c_str(),
+                                   String(id2).c_str(), 0);
+  assertEqual(entries.isError(), false);
+  assertEqual(entries.size(), (size_t)2);
+  assertEqual(entries[0].id(), String(id1));
+  assertEqual(entries[0].value("name"), "Serena");
+  assertEqual(entries[1].id(), String(id2));
+  assertEqual(entries[1].field(0), "name");
+  assertEqual(entries[1].value(0), "Allison");
+}
+
+static int streamedEntries;
+
+testF(IntegrationTests, xread_entries_callback)
+{
+  auto id1 = r->xadd("mystream", "*", "name", "Jesse");
+  r->xadd("mystream", "*", "name", "James");
+  r->xadd("mystream", "*", "name", "Jo");
+  streamedEntries = 0;
+  auto count = r->xread_entries(0, 0, "mystream", String(id1).c_str(),
+                                [](Redis *, const RedisStreamEntry &entry)
+                                {
+                                  if (entry.size() == 1 && entry.field(0) == "name")
+                                  {
+                                    streamedEntries++;
+                                  }
+                                });
+  assertEqual(count, 2);
+  assertEqual(streamedEntries, 2);
+}
+
 testF(IntegrationTests, xrevrange)
 {
   auto id1 = r->xadd("mystream", "*", "name", "Serena");
@@ -490,3 +618,279 @@ testF(IntegrationTests, xpending_xclaim)
   assertEqual(r->xgroup_destroy("stream", "group1"), 1);
   assertEqual(r->xgroup_destroy("stream", "group2"), 1);
 }
+
+testF(IntegrationTests, pipeline)
+{
+  defineKey("pipeline");
+
+  RedisPipeline pipe(*r);
+  auto hset = pipe.queue("HSET", ArgList{key, "f", "v"});
+  auto hget = pipe.queue("HGET", ArgList{key, "f"});
+  auto hlen = pipe.queue("HLEN", ArgList{key});
+  auto bad = pipe.queue("INCR", ArgList{key});
+  assertEqual(pipe.exec(), true);
+
+  assertEqual(pipe.reply_typed<int>(hset), 1);
+  assertEqual(pipe.reply_typed<String>(hget), String("v"));
+  assertEqual(pipe.reply_typed<int>(hlen), 1);
+  assertEqual(pipe.reply(bad)->type(), RedisObject::Type::Error);
+
+  // the connection must be left in sync for regular commands
+  assertEqual(r->hget(key, "f"), String("v"));
+}
+
+testF(IntegrationTests, ssubscribe_spublish)
+{
+  defineKey("shard");
+
+  auto subscriber = NewConnection();
+  assertNotEqual(subscriber.second.get(), nullptr);
+
+  static String received;
+  received = "";
+  assertEqual(subscriber.second->ssubscribe({key}), true);
+  assertEqual(subscriber.second->subscribe({String(key) + ".a", String(key) + ".b"}), true);
+  assertEqual(subscriber.second->beginSubscribing([](Redis *, const RedisMessage &msg)
+                                                  { received = String(msg.channel) + "=" + (const char *)msg.message; }),
+              RedisSubscribeSuccess);
+
+  assertEqual(r->spublish(key, "sharded"), 1);
+  auto start = millis();
+  while (received == "" && millis() - start < 1000)
+  {
+    assertEqual(subscriber.second->pollSubscriptions(), RedisSubscribeSuccess);
+  }
+  assertEqual(received, String(key) + "=sharded");
+
+  assertEqual(subscriber.second->unsubscribe(key), true);
+  subscriber.first->stop();
+}
+
+testF(IntegrationTests, hello3_resp3)
+{
+  defineKey("resp3");
+
+  assertEqual(r->hello(3), true);
+  assertEqual(r->hset(key, "temp", "21"), true);
+
+  auto all = RedisCommand::issue(*client, {"HGETALL", key});
+  assertEqual(all->wireType(), RedisObject::Type::Map);
+  assertEqual(((RedisArray *)all.get())->lookup("temp")->operator String(), String("21"));
+
+  // subscribed, the connection still carries commands, with messages delivered around their replies
+  static String received;
+  received = "";
+  assertEqual(r->subscribe(key), true);
+  assertEqual(r->beginSubscribing([](Redis *, String channel, String message)
+                                  { received = channel + "=" + message; }),
+              RedisSubscribeSuccess);
+
+  auto publisher = NewConnection();
+  assertNotEqual(publisher.second.get(), nullptr);
+  assertEqual(publisher.second->publish(key, "pushed"), 1);
+  publisher.first->stop();
+
+  auto start = millis();
+  while (received == "" && millis() - start < 1000)
+  {
+    assertEqual(r->hget(key, "temp"), String("21"));
+  }
+  assertEqual(received, String(key) + "=pushed");
+
+  assertEqual(r->unsubscribe(key), true);
+  assertEqual(r->hello(2), true);
+}
+
+testF(IntegrationTests, client_cache_tracking)
+{
+  defineKey("cached");
+
+  RedisClientCache cache;
+  assertEqual(r->set(key, "one"), true);
+  assertEqual(r->hello(3), true);
+  assertEqual(r->enableClientCache(cache), true);
+
+  assertEqual(r->get(key), String("one"));
+  assertEqual(r->get(key), String("one"));
+  assertEqual(cache.hits(), 1ul);
+
+  // another client's write is invalidated here, at the latest by the next command's reply
+  auto writer = NewConnection();
+  assertNotEqual(writer.second.get(), nullptr);
+  assertEqual(writer.second->set(key, "two"), true);
+  writer.first->stop();
+
+  auto start = millis();
+  while (cache.size() && millis() - start < 1000)
+  {
+    r->publish(key, "");
+  }
+  assertEqual(cache.invalidations(), 1ul);
+  assertEqual(r->get(key), String("two"));
+
+  r->disableClientCache();
+  assertEqual(r->hello(2), true);
+}
+
+testF(IntegrationTests, connection_reconnects)
+{
+  defineKey("reconnect");
+
+  const char *host = std::getenv("ARDUINO_REDIS_TEST_HOST");
+  const char *port = std::getenv("ARDUINO_REDIS_TEST_PORT");
+  TestRawClient raw;
+  RedisConnection connection(raw, host ? host : "localhost", port ? std::atoi(port) : 6379);
+  connection.setPassword(std::getenv("ARDUINO_REDIS_TEST_AUTH"));
+  connection.setRetryIdempotent(true);
+  assertEqual(connection.connect(), true);
+  assertEqual(connection.redis().set(key, "kept"), true);
+
+  // as though the access point had changed under the connection
+  raw.stop();
+  assertEqual(connection.redis().get(key), String("kept"));
+  assertEqual(connection.reconnects(), 1ul);
+  raw.stop();
+}
+
+testF(IntegrationTests, async_commands)
+{
+  defineKey("async");
+
+  static std::vector<String> replies;
+  replies.clear();
+  auto record = [](Redis *, std::shared_ptr<RedisObject> reply, void *)
+  { replies.push_back((String)*reply); };
+
+  assertEqual(r->setAsync(key, "1", record), true);
+  assertEqual(r->issueAsync("INCR", {key}, record), true);
+  assertEqual(r->getAsync(key, record), true);
+
+  auto start = millis();
+  while (r->pending() && millis() - start < 1000)
+  {
+    r->poll();
+  }
+  assertEqual(replies.size(), (size_t)3);
+  assertEqual(replies[0], String("OK"));
+  assertEqual(replies[1], String("2"));
+  assertEqual(replies[2], String("2"));
+}
+
+testF(IntegrationTests, transaction_exec)
+{
+  defineKey("tx");
+  String counter = String(key) + ".counter";
+
+  RedisTransaction tx(*r);
+  assertEqual(tx.watch({key}), true);
+  auto hset = tx.queue({"HSET", key, "state", "on"});
+  auto incr = tx.queue({"INCR", counter});
+  auto hget = tx.queue({"HGET", key, "state"});
+  assertEqual(tx.exec(), RedisTransactionCommitted);
+  assertEqual(tx.reply_typed<int>(hset), 1);
+  assertEqual(tx.reply_typed<int>(incr), 1);
+  assertEqual(tx.reply_typed<String>(hget), String("on"));
+
+  assertEqual(r->del(counter.c_str()), true);
+}
+
+testF(IntegrationTests, script_evalsha)
+{
+  defineKey("script");
+
+  static RedisScript echoKey("return KEYS[1]");
+  RedisCommand::issue(*client, {"SCRIPT", "FLUSH"});
+
+  // not yet loaded: loaded upon NOSCRIPT, then called again
+  assertEqual(echoKey.run_typed<String>(*r, {key}), String(key));
+  assertEqual(echoKey.run_typed<String>(*r, {"other"}), String("other"));
+  assertEqual(echoKey.load(*r), true);
+}
+
+testF(IntegrationTests, scan_keys_and_hash)
+{
+  defineKey("scan");
+
+  for (int i = 0; i < 25; i++)
+  {
+    r->set((String(key) + ":" + i).c_str(), "v");
+  }
+  r->hset(key, "f1", "v1");
+  r->hset(key, "f2", "v2");
+
+  auto pattern = String(key) + ":*";
+  RedisScan scan(*r);
+  scan.setMatch(pattern.c_str());
+  scan.setCount(4);
+  scan.setPrefetch(true);
+  std::set<std::string> seen;
+  String name;
+  while (scan.next(name))
+  {
+    seen.insert(name.c_str());
+  }
+  assertEqual(scan.error() == nullptr, true);
+  assertEqual(seen.size(), (size_t)25);
+
+  RedisScan fields(*r, RedisScanHash, key);
+  std::map<std::string, std::string> hash;
+  String field, value;
+  while (fields.next(field, value))
+  {
+    hash[field.c_str()] = value.c_str();
+  }
+  assertEqual(hash.size(), (size_t)2);
+  assertEqual(hash["f2"].c_str(), "v2");
+}
+
+testF(IntegrationTests, zset_window)
+{
+  defineKey("zset");
+  auto dst = String(key) + ".recent";
+
+  assertEqual(r->zadd(key, {{"r1", 100}, {"r2", 160}, {"r3", 220}, {"r4", 280}}), 4);
+  assertEqual(r->zadd(key, {{"r1", 50}}, "GT"), 0);
+  assertEqual(r->zincrby(key, 0.5, "r4"), 280.5);
+  assertEqual(r->zcard(key), 4);
+
+  auto window = r->zrange(key, "(100", "250", RedisZRangeByScore);
+  assertEqual(window.size(), (size_t)2);
+  assertEqual(window[0].member.c_str(), "r2");
+  assertEqual(window[1].score, 220.0);
+
+  auto latest = r->zrange(key, "+inf", "-inf", RedisZRangeByScore, true, 0, 1);
+  assertEqual(latest.size(), (size_t)1);
+  assertEqual(latest[0].member.c_str(), "r4");
+
+  assertEqual(r->zrangestore(dst.c_str(), key, "0", "1"), 2);
+  assertEqual(r->zremrangebyscore(key, "-inf", "160"), 2);
+
+  auto lowest = r->zpopmin(key, 5);
+  assertEqual(lowest.size(), (size_t)2);
+  assertEqual(lowest[0].member.c_str(), "r3");
+
+  RedisScoredMember popped;
+  String from;
+  assertEqual(r->bzpopmin({key, dst}, 1, popped, &from), true);
+  assertEqual(from.c_str(), dst.c_str());
+  assertEqual(popped.member.c_str(), "r1");
+  assertEqual(r->bzpopmin({key}, 0.1, popped), false);
+}
+
+testF(IntegrationTests, incr_64_bit)
+{
+  defineKey("counter");
+
+  assertEqual((long long)r->incr(key, 4000000000LL).value, 4000000000LL);
+  assertEqual((long long)r->incr(key).value, 4000000001LL);
+  assertEqual(r->get(key).c_str(), "4000000001");
+  assertEqual(r->incrbyfloat(key, 0.5).value, 4000000001.5);
+
+  // no longer an integer
+  auto refused = r->incr(key);
+  assertEqual(refused.ok(), false);
+  assertEqual(refused.status, RedisResultError);
+
+  assertEqual(r->pexpire(key, 2000000000), true);
+  assertMore((long long)r->pttl(key), 1999000000LL);
+}
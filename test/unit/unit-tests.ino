@@ -3,11 +3,21 @@
 
 #include <Redis.h>
 #include <RedisInternal.h>
+#include <RedisPipeline.h>
+#include <RedisClientCache.h>
+#include <RedisConnection.h>
+#include <RedisPool.h>
+#include <RedisTransaction.h>
+#include <RedisScript.h>
+#include <RedisScan.h>
 
 #include <AUnitVerbose.h>
 
+#include <thread>
+
 #include "../ArduinoRedisTestBase.h"
 #include "../TestDirectClient.h"
+#include "../LoopbackClient.h"
 
 using namespace aunit;
 
@@ -164,6 +174,35 @@ test(UnitTests, integers)
   }
 }
 
+test(UnitTests, integers_64_bit)
+{
+  std::vector<std::pair<String, int64_t>> test_vectors{
+      std::make_pair(":2147483648\r\n", 2147483648LL),
+      std::make_pair(":1700000000123\r\n", 1700000000123LL),
+      std::make_pair(":9223372036854775807\r\n", INT64_MAX),
+      std::make_pair(":-9223372036854775808\r\n", INT64_MIN),
+  };
+
+  for (const auto &test_vec : test_vectors)
+  {
+    parseRESP2String(test_vec.first.c_str());
+    assertEqual(parsed->type(), RedisObject::Type::Integer);
+    assertEqual((long long)((RedisInteger *)parsed.get())->value(), (long long)test_vec.second);
+  }
+
+  // formatted only when asked to be
+  RedisInteger big(INT64_MIN);
+  assertEqual(((String)big).c_str(), "-9223372036854775808");
+  assertEqual(big.RESP().c_str(), ":-9223372036854775808\r\n");
+
+  // and encoded without overflow as an argument
+  uint8_t buf[64];
+  RedisEncoder encoder(buf, sizeof(buf));
+  encoder.command({"INCRBY", "k", (long long)-5000000000LL});
+  assertEqual(std::string((const char *)buf, encoder.size()).c_str(),
+              "*3\r\n$6\r\nINCRBY\r\n$1\r\nk\r\n$11\r\n-5000000000\r\n");
+}
+
 test(UnitTests, bulk_strings)
 {
   std::vector<std::pair<String, String>> test_vectors{
@@ -186,6 +225,46 @@ test(UnitTests, null_bulk_string)
   assertEqual(Redis::isNilReturn(parsed->operator String()), true);
 }
 
+test(UnitTests, mget_preserves_nil_positions)
+{
+  TestDirectClient client("*3\r\n$1\r\n1\r\n$-1\r\n$1\r\n3\r\n");
+  Redis redis(client);
+
+  auto values = redis.mget({"a", "missing", "c"});
+  assertEqual(values.size(), (size_t)3);
+  assertEqual(values[0].c_str(), "1");
+  assertEqual(Redis::isNilReturn(values[1]), true);
+  assertEqual(values[2].c_str(), "3");
+}
+
+test(UnitTests, bulk_string_embedded_nul)
+{
+  const char reply[] = "$5\r\na\x00" "b\r\n\r\n";
+  parseRESP2String(std::string(reply, sizeof(reply) - 1));
+  assertEqual(parsed->type(), RedisObject::Type::BulkString);
+
+  auto bulk = (RedisBulkString *)parsed.get();
+  assertEqual(bulk->length(), (size_t)5);
+  assertEqual(memcmp(bulk->bytes(), "a\x00" "b\r\n", 5), 0);
+}
+
+test(UnitTests, get_into_caller_buffer)
+{
+  const char replies[] = "$4\r\n\x00\x01\x02\x03\r\n$6\r\nabcdef\r\n$-1\r\n-ERR\r\n";
+  TestDirectClient client(std::string(replies, sizeof(replies) - 1));
+  Redis redis(client);
+  uint8_t buf[4];
+
+  assertEqual(redis.get("fits", buf, sizeof(buf)), 4);
+  assertEqual(memcmp(buf, "\x00\x01\x02\x03", 4), 0);
+
+  assertEqual(redis.get("truncated", buf, sizeof(buf)), 6);
+  assertEqual(memcmp(buf, "abcd", 4), 0);
+
+  assertEqual(redis.get("nil", buf, sizeof(buf)), -1);
+  assertEqual(redis.get("error", buf, sizeof(buf)), -2);
+}
+
 test(UnitTests, non_RESP_data)
 {
   std::vector<String> vectors{
@@ -199,4 +278,1421 @@ test(UnitTests, non_RESP_data)
     parseRESP2String(fuzz_vec.c_str());
     assertEqual(parsed->type(), RedisObject::Type::InternalError);
   }
-}
\ No newline at end of file
+}
+// an XRANGE reply of two entries, the second with two fields
+const std::string xrange_vector = "*2\r\n"
+                                  "*2\r\n$3\r\n1-0\r\n*2\r\n$4\r\ntemp\r\n$2\r\n21\r\n"
+                                  "*2\r\n$3\r\n2-0\r\n*4\r\n$4\r\ntemp\r\n$2\r\n22\r\n$3\r\nhum\r\n$2\r\n40\r\n";
+
+static std::vector<String> streamedIds;
+
+test(UnitTests, stream_entries)
+{
+  TestDirectClient client(xrange_vector + "*1\r\n*2\r\n$6\r\nstream\r\n" + xrange_vector + "*-1\r\n-ERR no\r\n");
+  Redis redis(client);
+
+  auto range = redis.xrange_entries("stream", "-", "+", 0);
+  assertEqual(range.isError(), false);
+  assertEqual(range.size(), (size_t)2);
+  assertEqual(range[0].id().c_str(), "1-0");
+  assertEqual(range[0].size(), (size_t)1);
+  assertEqual(range[1].field(1).c_str(), "hum");
+  assertEqual(range[1].value(1).c_str(), "40");
+  assertEqual(range[1].value("temp").c_str(), "22");
+  assertEqual(Redis::isNilReturn(range[1].value("nope")), true);
+
+  auto read = redis.xread_entries(0, 0, "stream", "0");
+  assertEqual(read.size(), (size_t)2);
+  assertEqual(read[1].id().c_str(), "2-0");
+
+  auto timedOut = redis.xread_entries(0, 100, "stream", "$");
+  assertEqual(timedOut.isError(), false);
+  assertEqual(timedOut.size(), (size_t)0);
+
+  auto error = redis.xrange_entries("stream", "-", "+", 0);
+  assertEqual(error.isError(), true);
+  assertEqual(error.error().c_str(), "ERR no");
+}
+
+test(UnitTests, stream_entries_resp3)
+{
+  // under RESP3, XREAD replies with a map of each stream's key to its entries
+  TestDirectClient client("%0\r\n%1\r\n$6\r\nstream\r\n" + xrange_vector + "%1\r\n$6\r\nstream\r\n" +
+                          xrange_vector + "_\r\n");
+  Redis redis(client);
+  assertEqual(redis.hello(), true);
+
+  auto read = redis.xread_entries(0, 0, "stream", "0");
+  assertEqual(read.isError(), false);
+  assertEqual(read.size(), (size_t)2);
+  assertEqual(read[1].id().c_str(), "2-0");
+  assertEqual(read[1].value("temp").c_str(), "22");
+
+  streamedIds.clear();
+  auto count = redis.xread_entries(0, 0, "stream", "0",
+                                   [](Redis *, const RedisStreamEntry &entry)
+                                   { streamedIds.push_back(entry.id() + "/" + entry.value("temp")); });
+  assertEqual(count, 2);
+  assertEqual(streamedIds.size(), (size_t)2);
+  assertEqual(streamedIds[0].c_str(), "1-0/21");
+  assertEqual(streamedIds[1].c_str(), "2-0/22");
+
+  auto timedOut = redis.xread_entries(0, 100, "stream", "$");
+  assertEqual(timedOut.isError(), false);
+  assertEqual(timedOut.size(), (size_t)0);
+}
+
+test(UnitTests, stream_entries_callback)
+{
+  TestDirectClient client("*1\r\n*2\r\n$6\r\nstream\r\n" + xrange_vector + "+OK\r\n");
+  Redis redis(client);
+  streamedIds.clear();
+
+  auto count = redis.xreadgroup_entries("group", "consumer", 0, 0, false, "stream", ">",
+                                        [](Redis *, const RedisStreamEntry &entry)
+                                        { streamedIds.push_back(entry.id() + "/" + entry.value("temp")); });
+  assertEqual(count, 2);
+  assertEqual(streamedIds.size(), (size_t)2);
+  assertEqual(streamedIds[0].c_str(), "1-0/21");
+  assertEqual(streamedIds[1].c_str(), "2-0/22");
+
+  // the sink is only for the one reply
+  assertEqual(redis.set("k", "v"), true);
+}
+
+// records each visited element as "<depth><type><data>", and each aggregate as "<depth><type><count>"
+class RecordingVisitor : public RedisVisitor
+{
+public:
+  void aggregate(RedisObject::Type type, long count, size_t depth) override
+  {
+    events.push_back(String((int)depth) + (char)type + String(count));
+  }
+
+  void element(RedisObject::Type type, const uint8_t *data, size_t length, size_t depth) override
+  {
+    String event = String((int)depth) + (char)type;
+    if (data)
+    {
+      event.concat((const char *)data, length);
+    }
+    events.push_back(event);
+  }
+
+  std::vector<String> events;
+};
+
+test(UnitTests, visitor_streams_elements)
+{
+  TestDirectClient client(nested_array_vector + "*3\r\n$3\r\nfoo\r\n$-1\r\n*-1\r\n-ERR x\r\n+OK\r\n");
+  RedisReader reader(client);
+  RecordingVisitor visitor;
+
+  auto nested = RedisCommand::issue(reader, {"CMD"}, visitor);
+  assertEqual(nested->type(), RedisObject::Type::Array);
+  assertEqual(((std::vector<String>) * (RedisArray *)nested.get()).size(), (size_t)0);
+
+  auto bulks = RedisCommand::issue(reader, {"CMD"}, visitor);
+  assertEqual(bulks->type(), RedisObject::Type::Array);
+
+  auto error = RedisCommand::issue(reader, {"CMD"}, visitor);
+  assertEqual(error->type(), RedisObject::Type::Error);
+
+  std::vector<String> expected{"0*2", "1*3", "2:1", "2:2", "2:3", "1*2", "2+Hello", "2-World",
+                               "0*3", "1$foo", "1$", "1*-1",
+                               "0-ERR x"};
+  assertEqual(visitor.events.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++)
+  {
+    assertEqual(visitor.events[i].c_str(), expected[i].c_str());
+  }
+
+  // the visitor only applies to the reply it was given for
+  auto ok = RedisObject::parseType(reader);
+  assertEqual(ok->operator String().c_str(), "OK");
+  assertEqual(visitor.events.size(), expected.size());
+}
+
+test(UnitTests, resp3_types_framed)
+{
+  TestDirectClient client("%2\r\n+a\r\n:1\r\n+b\r\n~2\r\n#t\r\n_\r\n!5\r\nERR x\r\n,3.14\r\n");
+  RedisReader reader(client);
+
+  auto map = RedisObject::parseType(reader);
+  assertEqual(map->type(), RedisObject::Type::Array);
+  std::vector<std::shared_ptr<RedisObject>> pairs = *(RedisArray *)map.get();
+  assertEqual(pairs.size(), (size_t)4);
+
+  std::vector<std::shared_ptr<RedisObject>> set = *(RedisArray *)pairs[3].get();
+  assertEqual(set.size(), (size_t)2);
+  assertEqual(dynamic_cast<RedisInteger *>(set[0].get())->operator int(), 1);
+  assertEqual(Redis::isNilReturn(set[1]->operator String()), true);
+
+  auto blobError = RedisObject::parseType(reader);
+  assertEqual(blobError->type(), RedisObject::Type::Error);
+  assertEqual(blobError->operator String().c_str(), "ERR x");
+
+  auto dbl = RedisObject::parseType(reader);
+  assertEqual(dbl->operator String().c_str(), "3.14");
+}
+
+test(UnitTests, arena_alignment)
+{
+  RedisArena arena;
+  // odd sizes between, and the start of each new block, must still honour the alignment asked for
+  for (int i = 0; i < 200; i++)
+  {
+    assertNotEqual(arena.allocate(3, 1), nullptr);
+    auto wide = arena.allocate(sizeof(int64_t), alignof(int64_t));
+    assertEqual((uintptr_t)wide % alignof(int64_t), (uintptr_t)0);
+    auto strict = arena.allocate(8, 64);
+    assertEqual((uintptr_t)strict % 64, (uintptr_t)0);
+  }
+}
+
+test(UnitTests, arena_reply_outlives_parser)
+{
+  std::shared_ptr<RedisObject> kept;
+  {
+    TestDirectClient client(nested_array_vector + "*3\r\n$3\r\nfoo\r\n$-1\r\n$0\r\n\r\n");
+    RedisReader reader(client);
+    reader.parser().setArena(true);
+
+    auto nested = RedisObject::parseType(reader);
+    assertEqual(nested->RESP(), String(nested_array_vector.c_str()));
+
+    auto bulks = RedisObject::parseType(reader);
+    std::vector<std::shared_ptr<RedisObject>> elems = *(RedisArray *)bulks.get();
+    assertEqual(elems.size(), (size_t)3);
+    kept = elems[0];
+  }
+
+  // the arena lives on for as long as any of its objects does
+  assertEqual(kept->type(), RedisObject::Type::BulkString);
+  assertEqual(kept->operator String().c_str(), "foo");
+}
+
+test(UnitTests, pipeline_replies_in_order)
+{
+  TestDirectClient client(":1\r\n+OK\r\n$3\r\nbar\r\n$-1\r\n");
+  Redis redis(client);
+  RedisPipeline pipe(redis);
+
+  auto hset = pipe.queue("HSET", ArgList{"k", "f", "v"});
+  auto set = pipe.queue("SET", ArgList{"foo", "bar"});
+  auto get = pipe.queue("GET", ArgList{"foo"});
+  auto nil = pipe.queue("GET", ArgList{"nope"});
+  assertEqual(pipe.size(), (size_t)4);
+  assertEqual(pipe.exec(), true);
+
+  assertEqual(pipe.reply_typed<int>(hset), 1);
+  assertEqual(pipe.reply(set)->type(), RedisObject::Type::SimpleString);
+  assertEqual(pipe.reply_typed<String>(set), String("OK"));
+  assertEqual(pipe.reply_typed<String>(get), String("bar"));
+  assertEqual(Redis::isNilReturn(pipe.reply_typed<String>(nil)), true);
+  assertEqual(pipe.reply(nil + 1).get(), nullptr);
+}
+
+test(UnitTests, pipeline_reply_timed_out)
+{
+  LoopbackClient client("+OK\r\n$5\r\nab");
+  client.setTimeout(50);
+  Redis redis(client);
+  RedisPipeline pipe(redis);
+
+  auto set = pipe.queue("SET", ArgList{"foo", "bar"});
+  auto get = pipe.queue("GET", ArgList{"foo"});
+  auto last = pipe.queue("GET", ArgList{"baz"});
+
+  // the rest of a reply timed out part-way can't be told from the next: every later slot fails with it
+  assertEqual(pipe.exec(), false);
+  assertEqual(pipe.reply_typed<String>(set), String("OK"));
+  assertEqual(pipe.reply(get)->type(), RedisObject::Type::InternalError);
+  assertEqual(pipe.reply(last).get(), pipe.reply(get).get());
+}
+
+test(UnitTests, encoder_fixed_buffer)
+{
+  uint8_t buf[64];
+  String value("bar");
+  RedisEncoder enc(buf, sizeof(buf));
+  enc.command({"SET", "foo", value, -42, 1234567890UL});
+  assertEqual(enc.overflowed(), false);
+
+  const std::string expected = "*5\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$3\r\nbar\r\n$3\r\n-42\r\n$10\r\n1234567890\r\n";
+  assertEqual(enc.size(), expected.size());
+  assertEqual(std::string((const char *)buf, enc.size()).c_str(), expected.c_str());
+}
+
+test(UnitTests, encoder_fixed_buffer_overflow)
+{
+  uint8_t buf[16];
+  RedisEncoder enc(buf, sizeof(buf));
+  enc.command({"SET", "a-longer-key-name", "value"});
+  assertEqual(enc.overflowed(), true);
+}
+
+test(UnitTests, encoder_binary_args)
+{
+  uint8_t buf[32];
+  const uint8_t payload[] = {0x00, 0x01, '\r', '\n'};
+  RedisEncoder enc(buf, sizeof(buf));
+  enc.command({"SET", "k", RedisArg(payload, sizeof(payload))});
+  assertEqual(enc.overflowed(), false);
+
+  const char expectedBytes[] = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$4\r\n\x00\x01\r\n\r\n";
+  const std::string expected(expectedBytes, sizeof(expectedBytes) - 1);
+  assertEqual(enc.size(), expected.size());
+  assertEqual(memcmp(buf, expected.data(), expected.size()), 0);
+}
+
+test(UnitTests, reader_consecutive_replies)
+{
+  TestDirectClient client("+OK\r\n$5\r\nhello\r\n*2\r\n:1\r\n$-1\r\n:42\r\n");
+  RedisReader reader(client);
+
+  auto first = RedisObject::parseType(reader);
+  assertEqual(first->type(), RedisObject::Type::SimpleString);
+  assertEqual(first->operator String().c_str(), "OK");
+
+  auto second = RedisObject::parseType(reader);
+  assertEqual(second->type(), RedisObject::Type::BulkString);
+  assertEqual(second->operator String().c_str(), "hello");
+
+  auto third = RedisObject::parseType(reader);
+  assertEqual(third->type(), RedisObject::Type::Array);
+  assertEqual(dynamic_cast<RedisArray *>(third.get())->operator std::vector<String>().size(), (size_t)2);
+
+  auto fourth = RedisObject::parseType(reader);
+  assertEqual(fourth->type(), RedisObject::Type::Integer);
+  assertEqual(dynamic_cast<RedisInteger *>(fourth.get())->operator int(), 42);
+
+  assertEqual(reader.available(), 0);
+}
+
+test(UnitTests, reader_bulk_larger_than_buffer)
+{
+  std::string payload;
+  for (int i = 0; i < REDIS_READER_BUFFER_SIZE * 3 + 7; i++)
+  {
+    payload += (char)('a' + (i % 26));
+  }
+
+  TestDirectClient client("$" + std::to_string(payload.size()) + "\r\n" + payload + "\r\n+OK\r\n");
+  RedisReader reader(client);
+
+  auto bulk = RedisObject::parseType(reader);
+  assertEqual(bulk->type(), RedisObject::Type::BulkString);
+  assertEqual(bulk->operator String().c_str(), payload.c_str());
+
+  auto next = RedisObject::parseType(reader);
+  assertEqual(next->type(), RedisObject::Type::SimpleString);
+}
+
+test(UnitTests, parse_resumes_across_partial_input)
+{
+  TestDirectClient client("*3\r\n$5\r\nhel");
+  RedisReader reader(client);
+
+  assertEqual(RedisObject::parseTypeNonBlocking(reader).get(), nullptr);
+  assertEqual(reader.parser().inProgress(), true);
+
+  client.append("lo\r");
+  assertEqual(RedisObject::parseTypeNonBlocking(reader).get(), nullptr);
+  client.append("\n*1\r\n:4");
+  assertEqual(RedisObject::parseTypeNonBlocking(reader).get(), nullptr);
+  client.append("2\r\n+O");
+  assertEqual(RedisObject::parseTypeNonBlocking(reader).get(), nullptr);
+  client.append("K\r\n+next\r\n");
+
+  auto parsed = RedisObject::parseTypeNonBlocking(reader);
+  assertNotEqual(parsed.get(), nullptr);
+  assertEqual(reader.parser().inProgress(), false);
+  assertEqual(parsed->type(), RedisObject::Type::Array);
+
+  std::vector<std::shared_ptr<RedisObject>> elems = *(RedisArray *)parsed.get();
+  assertEqual(elems.size(), (size_t)3);
+  assertEqual(elems[0]->operator String().c_str(), "hello");
+  assertEqual(elems[1]->type(), RedisObject::Type::Array);
+  assertEqual(((std::vector<String>) * (RedisArray *)elems[1].get())[0].c_str(), "42");
+  assertEqual(elems[2]->operator String().c_str(), "OK");
+
+  // the following reply was left intact
+  auto next = RedisObject::parseTypeNonBlocking(reader);
+  assertNotEqual(next.get(), nullptr);
+  assertEqual(next->operator String().c_str(), "next");
+}
+
+test(UnitTests, loopback_fragmented_reply_parses)
+{
+  const std::string replies = nested_array_vector + "$10\r\n0123456789\r\n:-7\r\n";
+
+  // however the replies are split, by a single byte or across every element boundary, they parse the same
+  for (size_t chunk : {1, 2, 3, 7, 64})
+  {
+    LoopbackClient client(replies);
+    client.setChunkSize(chunk);
+    RedisReader reader(client);
+
+    auto array = RedisObject::parseType(reader);
+    assertEqual(array->type(), RedisObject::Type::Array);
+    assertEqual(array->RESP().c_str(), nested_array_vector.c_str());
+
+    auto bulk = RedisObject::parseType(reader);
+    assertEqual(bulk->type(), RedisObject::Type::BulkString);
+    assertEqual(bulk->operator String().c_str(), "0123456789");
+
+    auto integer = RedisObject::parseType(reader);
+    assertEqual(integer->type(), RedisObject::Type::Integer);
+    assertEqual((int)*(RedisInteger *)integer.get(), -7);
+    assertEqual(client.available(), 0);
+  }
+}
+
+test(UnitTests, loopback_captures_pipelined_writes)
+{
+  LoopbackClient client;
+  client.script("+OK\r\n:1\r\n");
+  Redis redis(client);
+
+  RedisPipeline pipe(redis);
+  pipe.queue({"SET", "k", "v"});
+  pipe.queue({"INCR", "n"});
+  assertEqual(pipe.exec(), true);
+
+  // both commands went out in a single write, ahead of either reply being read
+  assertEqual(client.writeCalls(), (size_t)1);
+  assertEqual(client.written().c_str(), "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n*2\r\n$4\r\nINCR\r\n$1\r\nn\r\n");
+  assertEqual(pipe.reply_typed<int>(1), 1);
+}
+
+test(UnitTests, loopback_latency_delays_reply)
+{
+  LoopbackClient client("+late\r\n");
+  client.setLatency(20000);
+  client.write((const uint8_t *)"PING\r\n", 6);
+  RedisReader reader(client);
+
+  assertEqual(RedisObject::parseTypeNonBlocking(reader).get(), nullptr);
+  assertEqual(reader.parser().inProgress(), false);
+
+  delay(25);
+  auto parsed = RedisObject::parseTypeNonBlocking(reader);
+  assertNotEqual(parsed.get(), nullptr);
+  assertEqual(parsed->operator String().c_str(), "late");
+}
+
+const std::string subscribe_confirmation = "*3\r\n$9\r\nsubscribe\r\n$1\r\na\r\n:1\r\n";
+
+// records "channel=message" for each message received, into the std::vector<std::string> test context
+static void recordMessage(Redis *redis, String channel, String message)
+{
+  auto received = (std::vector<std::string> *)redis->getTestContext();
+  received->push_back(std::string(channel.c_str()) + "=" + message.c_str());
+  if (message == "stop")
+  {
+    redis->stopSubscribing();
+  }
+}
+
+test(UnitTests, subscriber_poll_step)
+{
+  std::vector<std::string> received;
+  LoopbackClient client(subscribe_confirmation);
+  Redis redis(client);
+  redis.setTestContext(&received);
+
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeBadCallback);
+  assertEqual(redis.subscribe("a"), true);
+  assertEqual(redis.beginSubscribing(recordMessage), RedisSubscribeSuccess);
+  assertEqual(client.written().c_str(), "*2\r\n$9\r\nSUBSCRIBE\r\n$1\r\na\r\n");
+
+  // nothing has arrived
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)0);
+
+  // half a message is kept until the rest arrives
+  client.script("*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$2");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)0);
+
+  client.script("\r\nhi\r\n*4\r\n$8\r\npmessage\r\n$2\r\nb*\r\n$2\r\nbc\r\n$3\r\nyes\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)2);
+  assertEqual(received[0].c_str(), "a=hi");
+  assertEqual(received[1].c_str(), "bc=yes");
+
+  // once stopped, nothing more is handled
+  client.script("*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$4\r\nstop\r\n*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$4\r\nlost\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)3);
+  assertEqual(received[2].c_str(), "a=stop");
+}
+
+static unsigned long gLoopCalls = 0;
+
+test(UnitTests, subscriber_backoff_idle)
+{
+  std::vector<std::string> received;
+  // the confirmation, then the message in two parts, each arriving 30ms after the last
+  LoopbackClient client(subscribe_confirmation + "*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$4\r\nstop\r\n");
+  client.setChunkSize(subscribe_confirmation.size());
+  client.setLatency(30000);
+  Redis redis(client);
+  redis.setTestContext(&received);
+  redis.setSubscriberIdle(RedisIdleBackoff, 5);
+
+  gLoopCalls = 0;
+  redis.subscribe("a");
+  auto result = redis.startSubscribingNonBlocking(recordMessage, []
+                                                  { gLoopCalls++; });
+  assertEqual(result, RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)1);
+
+  // ~60ms of waiting in sleeps of at most 5ms, rather than a busy loop of many thousands of polls
+  assertMore(gLoopCalls, 5ul);
+  assertLess(gLoopCalls, 100ul);
+}
+
+test(UnitTests, subscriber_message_views)
+{
+  static std::vector<std::string> received;
+  received.clear();
+
+  const char messages[] = "*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$3\r\nx\x00y\r\n"
+                          "*4\r\n$8\r\npmessage\r\n$2\r\nb*\r\n$2\r\nbc\r\n$3\r\nyes\r\n"
+                          "*3\r\n$8\r\npmessage\r\n$2\r\nb*\r\n$2\r\nbc\r\n"
+                          "*3\r\n$7\r\nmessage\r\n:1\r\n$1\r\nz\r\n";
+  LoopbackClient client(std::string(messages, sizeof(messages) - 1));
+  Redis redis(client);
+
+  auto errors = 0;
+  redis.setTestContext(&errors);
+  assertEqual(redis.beginSubscribing(
+                  [](Redis *, const RedisMessage &msg)
+                  {
+                    received.push_back((msg.pattern ? std::string(msg.pattern, msg.patternLength) : "-") + " " +
+                                       std::string(msg.channel, msg.channelLength) + " " +
+                                       std::string((const char *)msg.message, msg.messageLength));
+                  },
+                  [](Redis *redis, RedisMessageError)
+                  { (*(int *)redis->getTestContext())++; }),
+              RedisSubscribeSuccess);
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+
+  assertEqual(received.size(), (size_t)2);
+  // the payload is delivered whole, embedded NUL and all
+  assertEqual(received[0].size(), (size_t)7);
+  assertEqual(received[0].substr(0, 4).c_str(), "- a ");
+  assertEqual(memcmp(received[0].data() + 4, "x\0y", 3), 0);
+  assertEqual(received[1].c_str(), "b* bc yes");
+
+  // a pmessage missing its payload, and a message whose channel is not a bulk string
+  assertEqual(errors, 2);
+}
+
+// a RESP2 (un)subscription confirmation
+static std::string confirmation(const char *kind, const char *name, int count)
+{
+  return std::string("*3\r\n$") + std::to_string(strlen(kind)) + "\r\n" + kind + "\r\n$" +
+         std::to_string(strlen(name)) + "\r\n" + name + "\r\n:" + std::to_string(count) + "\r\n";
+}
+
+test(UnitTests, subscriber_batched_subscribe)
+{
+  std::vector<std::string> received;
+  LoopbackClient client(confirmation("subscribe", "a", 1) +
+                        // a message may arrive as soon as its channel's subscription is confirmed
+                        "*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$5\r\nearly\r\n" +
+                        confirmation("subscribe", "b", 2) + confirmation("psubscribe", "p*", 3) +
+                        confirmation("ssubscribe", "s1", 4) + confirmation("ssubscribe", "s2", 5));
+  Redis redis(client);
+  redis.setTestContext(&received);
+
+  assertEqual(redis.subscribe({"a", "b"}), true);
+  assertEqual(redis.subscribe("a"), true);
+  assertEqual(redis.psubscribe({"p*"}), true);
+  assertEqual(redis.ssubscribe({"s1", "s2"}), true);
+  assertEqual(client.written().size(), (size_t)0);
+
+  // one command per kind, but one per shard channel, all written before any confirmation is read
+  assertEqual(redis.beginSubscribing(recordMessage), RedisSubscribeSuccess);
+  assertEqual(client.written().c_str(),
+              "*3\r\n$9\r\nSUBSCRIBE\r\n$1\r\na\r\n$1\r\nb\r\n"
+              "*2\r\n$10\r\nPSUBSCRIBE\r\n$2\r\np*\r\n"
+              "*2\r\n$10\r\nSSUBSCRIBE\r\n$2\r\ns1\r\n*2\r\n$10\r\nSSUBSCRIBE\r\n$2\r\ns2\r\n");
+  assertEqual(received.size(), (size_t)1);
+  assertEqual(received[0].c_str(), "a=early");
+  assertEqual(client.available(), 0);
+
+  // in subscription mode, (un)subscribing is sent at once, and the confirmations are consumed along with messages
+  client.clearWritten();
+  assertEqual(redis.unsubscribe({"b", "p*", "s1"}), true);
+  assertEqual(redis.subscribe("c"), true);
+  assertEqual(client.written().c_str(),
+              "*2\r\n$11\r\nUNSUBSCRIBE\r\n$1\r\nb\r\n"
+              "*2\r\n$12\r\nPUNSUBSCRIBE\r\n$2\r\np*\r\n"
+              "*2\r\n$12\r\nSUNSUBSCRIBE\r\n$2\r\ns1\r\n"
+              "*2\r\n$9\r\nSUBSCRIBE\r\n$1\r\nc\r\n");
+
+  client.script(confirmation("unsubscribe", "b", 4) + confirmation("punsubscribe", "p*", 3) +
+                confirmation("sunsubscribe", "s1", 2) + confirmation("subscribe", "c", 3) +
+                "*3\r\n$8\r\nsmessage\r\n$2\r\ns2\r\n$5\r\nshard\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)2);
+  assertEqual(received[1].c_str(), "s2=shard");
+}
+
+test(UnitTests, subscriber_refused_subscribe)
+{
+  std::vector<std::string> received;
+  // SUBSCRIBE is confirmed, but one SSUBSCRIBE refused (as by a cluster node not serving its slot)
+  LoopbackClient client(confirmation("subscribe", "a", 1) + "-MOVED 1 10.0.0.2:6379\r\n" +
+                        confirmation("ssubscribe", "s2", 2) + confirmation("unsubscribe", "a", 1) +
+                        confirmation("sunsubscribe", "s1", 1) + confirmation("sunsubscribe", "s2", 0) +
+                        "$2\r\nok\r\n");
+  Redis redis(client);
+  redis.setTestContext(&received);
+
+  assertEqual(redis.subscribe("a"), true);
+  assertEqual(redis.ssubscribe({"s1", "s2"}), true);
+  assertEqual(redis.beginSubscribing(recordMessage), RedisSubscribeSetupFailure);
+
+  // every subscription is undone, each confirmation read, and the connection usable for commands again
+  assertEqual(client.written().c_str(),
+              "*2\r\n$9\r\nSUBSCRIBE\r\n$1\r\na\r\n"
+              "*2\r\n$10\r\nSSUBSCRIBE\r\n$2\r\ns1\r\n*2\r\n$10\r\nSSUBSCRIBE\r\n$2\r\ns2\r\n"
+              "*2\r\n$11\r\nUNSUBSCRIBE\r\n$1\r\na\r\n"
+              "*2\r\n$12\r\nSUNSUBSCRIBE\r\n$2\r\ns1\r\n*2\r\n$12\r\nSUNSUBSCRIBE\r\n$2\r\ns2\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeBadCallback);
+  assertEqual(redis.get("k").c_str(), "ok");
+  assertEqual(received.size(), (size_t)0);
+}
+
+test(UnitTests, resp3_wire_types)
+{
+  TestDirectClient client("%2\r\n$4\r\nname\r\n=15\r\ntxt:Some string\r\n+len\r\n,1.5\r\n"
+                          "~1\r\n#f\r\n_\r\n(3492890328409238509324850943850943825024385\r\n*2\r\n:1\r\n:2\r\n");
+  RedisReader reader(client);
+
+  auto map = RedisObject::parseType(reader);
+  assertEqual(map->type(), RedisObject::Type::Array);
+  assertEqual(map->wireType(), RedisObject::Type::Map);
+
+  auto name = ((RedisArray *)map.get())->lookup("name");
+  assertNotEqual(name.get(), nullptr);
+  assertEqual(name->type(), RedisObject::Type::BulkString);
+  assertEqual(name->wireType(), RedisObject::Type::VerbatimString);
+  // the "txt:" format prefix is not part of the string
+  assertEqual(name->operator String().c_str(), "Some string");
+  assertEqual(((RedisBulkString *)name.get())->length(), (size_t)11);
+
+  auto len = ((RedisArray *)map.get())->lookup("len");
+  assertEqual(len->wireType(), RedisObject::Type::Double);
+  assertEqual(len->operator String().c_str(), "1.5");
+  assertEqual(((RedisArray *)map.get())->lookup("missing").get(), nullptr);
+
+  auto set = RedisObject::parseType(reader);
+  assertEqual(set->type(), RedisObject::Type::Array);
+  assertEqual(set->wireType(), RedisObject::Type::Set);
+  auto boolean = ((RedisArray *)set.get())->at(0);
+  assertEqual(boolean->type(), RedisObject::Type::Integer);
+  assertEqual(boolean->wireType(), RedisObject::Type::Boolean);
+  assertEqual((int)*(RedisInteger *)boolean.get(), 0);
+
+  auto null = RedisObject::parseType(reader);
+  assertEqual(null->wireType(), RedisObject::Type::Null);
+  assertEqual(((RedisBulkString *)null.get())->isNilReturn(), true);
+
+  auto big = RedisObject::parseType(reader);
+  assertEqual(big->wireType(), RedisObject::Type::BigNumber);
+  assertEqual(big->operator String().c_str(), "3492890328409238509324850943850943825024385");
+
+  // RESP2 types are as they always were
+  auto array = RedisObject::parseType(reader);
+  assertEqual(array->type(), RedisObject::Type::Array);
+  assertEqual(array->wireType(), RedisObject::Type::Array);
+}
+
+test(UnitTests, resp3_push_routed_around_replies)
+{
+  static std::vector<std::string> pushes;
+  pushes.clear();
+
+  const std::string invalidate = ">2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nfoo\r\n";
+  LoopbackClient client("%1\r\n$5\r\nproto\r\n:3\r\n" + invalidate + "$3\r\nbar\r\n" + invalidate + "$3\r\nbaz\r\n");
+  Redis redis(client);
+  redis.setPushHandler([](Redis *, std::shared_ptr<RedisObject> push)
+                       { pushes.push_back(((std::vector<String>)*(RedisArray *)push.get())[1].c_str()); });
+
+  assertEqual(redis.hello(), true);
+  assertEqual(client.written().c_str(), "*2\r\n$5\r\nHELLO\r\n$1\r\n3\r\n");
+
+  // a push frame ahead of a reply is handed to the handler, not mistaken for the reply
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(pushes.size(), (size_t)1);
+  assertEqual(pushes[0].c_str(), "foo");
+
+  // nor does it take the place of the reply in a caller's buffer
+  uint8_t buf[8];
+  assertEqual(redis.get("foo", buf, sizeof(buf)), 3);
+  assertEqual(memcmp(buf, "baz", 3), 0);
+  assertEqual(pushes.size(), (size_t)2);
+
+  // or a visitor's
+  client.script(invalidate + "*2\r\n$1\r\nx\r\n$1\r\ny\r\n");
+  RecordingVisitor visitor;
+  assertEqual(redis.lrange("list", 0, -1, visitor), 2);
+  assertEqual(visitor.events.size(), (size_t)3);
+  assertEqual(visitor.events[2].c_str(), "1$y");
+  assertEqual(pushes.size(), (size_t)3);
+}
+
+test(UnitTests, resp3_pubsub_shares_command_connection)
+{
+  std::vector<std::string> received;
+  LoopbackClient client(">3\r\n$9\r\nsubscribe\r\n$1\r\na\r\n:1\r\n");
+  Redis redis(client);
+  redis.setTestContext(&received);
+
+  redis.subscribe("a");
+  assertEqual(redis.beginSubscribing(recordMessage), RedisSubscribeSuccess);
+
+  // messages arriving while a command awaits its reply are delivered then and there
+  client.script(">3\r\n$7\r\nmessage\r\n$1\r\na\r\n$3\r\none\r\n:7\r\n");
+  assertEqual(redis.publish("b", "x"), 7);
+  assertEqual(received.size(), (size_t)1);
+  assertEqual(received[0].c_str(), "a=one");
+
+  // and otherwise when polled, confirmations of later subscriptions being consumed along the way
+  redis.subscribe("c");
+  client.script(">3\r\n$9\r\nsubscribe\r\n$1\r\nc\r\n:2\r\n>3\r\n$7\r\nmessage\r\n$1\r\nc\r\n$3\r\ntwo\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)2);
+  assertEqual(received[1].c_str(), "c=two");
+}
+
+test(UnitTests, client_cache_lru)
+{
+  RedisClientCache cache(2, 16);
+  String value;
+
+  cache.store("a", nullptr, "1");
+  cache.store("b", nullptr, "2");
+  assertEqual(cache.lookup("a", nullptr, value), true);
+  assertEqual(value.c_str(), "1");
+
+  // "b" is now the least recently read, so makes room for "c"
+  cache.store("c", nullptr, "3");
+  assertEqual(cache.size(), (size_t)2);
+  assertEqual(cache.evictions(), 1ul);
+  assertEqual(cache.lookup("b", nullptr, value), false);
+  assertEqual(cache.lookup("c", nullptr, value), true);
+  assertEqual(value.c_str(), "3");
+
+  // what doesn't fit a slot isn't cached, nor evicts anything
+  cache.store("d", nullptr, "0123456789abcdef");
+  assertEqual(cache.lookup("d", nullptr, value), false);
+  assertEqual(cache.evictions(), 1ul);
+
+  // a key's fields are distinct entries, all dropped with the key
+  cache.clear();
+  cache.store("h", "f1", "x");
+  cache.store("h", "f2", "y");
+  assertEqual(cache.lookup("h", nullptr, value), false);
+  assertEqual(cache.lookup("h", "f2", value), true);
+  assertEqual(value.c_str(), "y");
+  cache.invalidate("h", 1);
+  assertEqual(cache.size(), (size_t)0);
+  assertEqual(cache.lookup("h", "f1", value), false);
+
+  assertEqual(cache.hits(), 3ul);
+  assertEqual(cache.misses(), 4ul);
+  assertEqual(cache.invalidations(), 4ul);
+}
+
+test(UnitTests, client_cache_limits)
+{
+  // a slot can hold no more than 65535 bytes, however much is asked for
+  RedisClientCache cache(1, 70000);
+  String value;
+
+  cache.store("k", nullptr, String(std::string(65534, 'x').c_str()));
+  assertEqual(cache.lookup("k", nullptr, value), true);
+  assertEqual(value.length(), 65534u);
+
+  cache.store("j", nullptr, String(std::string(65535, 'y').c_str()));
+  assertEqual(cache.lookup("j", nullptr, value), false);
+}
+
+test(UnitTests, client_cache_tracking_resp3)
+{
+  LoopbackClient client("%1\r\n$5\r\nproto\r\n:3\r\n+OK\r\n$3\r\nbar\r\n$2\r\non\r\n");
+  Redis redis(client);
+  RedisClientCache cache;
+
+  // tracking needs RESP3 for the invalidations to reach this connection
+  assertEqual(redis.enableClientCache(cache), false);
+  assertEqual(redis.hello(), true);
+  assertEqual(redis.enableClientCache(cache), true);
+
+  client.clearWritten();
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(redis.hget("cfg", "mode").c_str(), "on");
+  assertEqual(redis.hget("cfg", "mode").c_str(), "on");
+  assertEqual(client.written().c_str(), "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n*3\r\n$4\r\nHGET\r\n$3\r\ncfg\r\n$4\r\nmode\r\n");
+  assertEqual(cache.hits(), 2ul);
+
+  // an invalidation arriving ahead of a reply drops the key; a null one, everything
+  client.script(">2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nfoo\r\n:1\r\n$3\r\nnew\r\n");
+  assertEqual(redis.publish("other", "x"), 1);
+  assertEqual(cache.size(), (size_t)1);
+  assertEqual(redis.get("foo").c_str(), "new");
+
+  client.script(">2\r\n$10\r\ninvalidate\r\n_\r\n:2\r\n");
+  assertEqual(redis.publish("other", "x"), 2);
+  assertEqual(cache.size(), (size_t)0);
+  assertEqual(cache.invalidations(), 3ul);
+
+  // a key invalidated while its value is read (as when redirected to a connection polled meanwhile) isn't cached
+  client.script(">2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nfoo\r\n$5\r\nstale\r\n$5\r\nfresh\r\n");
+  assertEqual(redis.get("foo").c_str(), "stale");
+  assertEqual(cache.size(), (size_t)0);
+  assertEqual(redis.get("foo").c_str(), "fresh");
+  assertEqual(cache.size(), (size_t)1);
+}
+
+test(UnitTests, client_cache_redirected_invalidations)
+{
+  std::vector<std::string> received;
+  LoopbackClient commands("+OK\r\n$3\r\nbar\r\n");
+  LoopbackClient subscriber(":42\r\n*3\r\n$9\r\nsubscribe\r\n$20\r\n__redis__:invalidate\r\n:1\r\n");
+  Redis redis(commands), invalidations(subscriber);
+  invalidations.setTestContext(&received);
+  RedisClientCache cache;
+
+  assertEqual(redis.enableClientCache(cache, invalidations), true);
+  assertEqual(commands.written().c_str(), "*5\r\n$6\r\nCLIENT\r\n$8\r\nTRACKING\r\n$2\r\nON\r\n$8\r\nREDIRECT\r\n$2\r\n42\r\n");
+  assertEqual(invalidations.beginSubscribing(recordMessage), RedisSubscribeSuccess);
+
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(cache.size(), (size_t)1);
+
+  // the invalidation's array of keys is for the cache, not the message callback
+  subscriber.script("*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*1\r\n$3\r\nfoo\r\n");
+  assertEqual(invalidations.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(cache.size(), (size_t)0);
+  assertEqual(received.size(), (size_t)0);
+
+  // disabling the cache leaves the channel, and any invalidation still on its way is no longer applied
+  commands.script("+OK\r\n");
+  subscriber.clearWritten();
+  redis.disableClientCache();
+  assertEqual(subscriber.written().c_str(), "*2\r\n$11\r\nUNSUBSCRIBE\r\n$20\r\n__redis__:invalidate\r\n");
+
+  cache.store("foo", nullptr, "kept");
+  subscriber.script("*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*1\r\n$3\r\nfoo\r\n" +
+                    confirmation("unsubscribe", "__redis__:invalidate", 0));
+  assertEqual(invalidations.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(cache.size(), (size_t)1);
+}
+
+test(UnitTests, connection_auth_failure)
+{
+  LoopbackClient client("-WRONGPASS invalid username-password pair\r\n");
+  RedisConnection connection(client, "redis.local");
+  connection.setPassword("wrong");
+
+  // told apart from the server being unreachable, as retrying won't help
+  assertEqual(connection.connect(), false);
+  assertEqual(connection.lastFailure(), RedisAuthFailure);
+
+  client.script("+OK\r\n");
+  assertEqual(connection.connect(), true);
+  assertEqual(connection.lastFailure(), RedisSuccess);
+
+  // a connect() failing with a negative code (as EthernetClient's may) is no connection to restore
+  LoopbackClient refusing;
+  refusing.setRefuseConnections(true, -1);
+  RedisConnection unreachable(refusing, "redis.local");
+  assertEqual(unreachable.connect(), false);
+  assertEqual(unreachable.lastFailure(), RedisNotConnectedFailure);
+}
+
+test(UnitTests, connection_restores_state)
+{
+  LoopbackClient client("+OK\r\n+OK\r\n");
+  RedisConnection connection(client, "redis.local");
+  connection.setPassword("pw");
+  connection.setDatabase(2);
+  connection.setRetryIdempotent(true);
+  Redis &redis = connection.redis();
+
+  assertEqual(connection.connect(), true);
+  const std::string handshake = "*2\r\n$4\r\nAUTH\r\n$2\r\npw\r\n*2\r\n$6\r\nSELECT\r\n$1\r\n2\r\n";
+  assertEqual(client.written(), handshake);
+
+  // an idempotent command is issued again on the new connection
+  client.drop();
+  client.clearWritten();
+  client.script("+OK\r\n+OK\r\n$3\r\nbar\r\n");
+  assertEqual(redis.get("foo").c_str(), "bar");
+  assertEqual(client.written(), handshake + "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+  assertEqual(connection.reconnects(), 1ul);
+
+  // any other fails, having perhaps been applied, but the next command finds the connection restored
+  client.drop();
+  client.clearWritten();
+  client.script("+OK\r\n+OK\r\n:1\r\n");
+  assertNotEqual(redis.publish("c", "m"), 1);
+  assertEqual(redis.publish("c", "m"), 1);
+  assertEqual(client.written(), handshake + "*3\r\n$7\r\nPUBLISH\r\n$1\r\nc\r\n$1\r\nm\r\n");
+  assertEqual(connection.reconnects(), 2ul);
+
+  // SET included: written again, it could undo another client's SET in between
+  client.drop();
+  client.clearWritten();
+  client.script("+OK\r\n+OK\r\n+OK\r\n");
+  assertEqual(redis.set("k", "v"), false);
+  assertEqual(redis.set("k", "v"), true);
+  assertEqual(client.written(), handshake + "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n");
+  assertEqual(connection.reconnects(), 3ul);
+}
+
+test(UnitTests, connection_backoff)
+{
+  LoopbackClient client;
+  RedisConnection connection(client, "redis.local");
+  connection.setBackoff(20, 20);
+  connection.setRetryIdempotent(true);
+  assertEqual(connection.connect(), true);
+
+  // the first attempt is immediate; once it fails, the next waits out the backoff
+  client.drop();
+  client.setRefuseConnections(true);
+  assertEqual(connection.redis().get("foo").c_str(), "");
+  assertEqual(client.connects(), (size_t)2);
+  assertEqual(connection.maintain(), false);
+  assertEqual(client.connects(), (size_t)2);
+
+  client.setRefuseConnections(false);
+  delay(25);
+  assertEqual(connection.maintain(), true);
+  assertEqual(client.connects(), (size_t)3);
+  assertEqual(connection.maintain(), true);
+  assertEqual(client.connects(), (size_t)3);
+}
+
+test(UnitTests, connection_resubscribes)
+{
+  std::vector<std::string> received;
+  LoopbackClient client(confirmation("subscribe", "a", 1) + confirmation("psubscribe", "p*", 2));
+  RedisConnection connection(client, "redis.local");
+  Redis &redis = connection.redis();
+  redis.setTestContext(&received);
+
+  redis.subscribe("a");
+  redis.psubscribe("p*");
+  assertEqual(redis.beginSubscribing(recordMessage), RedisSubscribeSuccess);
+
+  // the subscriber carries on without seeing the connection lost, subscribed as before
+  client.drop();
+  client.clearWritten();
+  client.script(confirmation("subscribe", "a", 1) + confirmation("psubscribe", "p*", 2) +
+                "*3\r\n$7\r\nmessage\r\n$1\r\na\r\n$5\r\nagain\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(client.written().c_str(), "*2\r\n$9\r\nSUBSCRIBE\r\n$1\r\na\r\n*2\r\n$10\r\nPSUBSCRIBE\r\n$2\r\np*\r\n");
+  assertEqual(redis.pollSubscriptions(), RedisSubscribeSuccess);
+  assertEqual(received.size(), (size_t)1);
+  assertEqual(received[0].c_str(), "a=again");
+  assertEqual(connection.reconnects(), 1ul);
+}
+
+test(UnitTests, pool_leases)
+{
+  LoopbackClient clientA(":1\r\n"), clientB(":2\r\n");
+  Redis redisA(clientA), redisB(clientB);
+  RedisPool pool({&redisA, &redisB});
+
+  auto first = pool.tryAcquire();
+  auto second = pool.acquire(10);
+  assertEqual((bool)first, true);
+  assertEqual((bool)second, true);
+  assertNotEqual(&*first, &*second);
+  assertEqual(pool.available(), (size_t)0);
+
+  // every connection is leased, so none is to be had, even after a wait
+  assertEqual((bool)pool.acquire(5), false);
+
+  // each lease has its connection to itself
+  assertEqual(first->publish("c", "m") + second->publish("c", "m"), 3);
+
+  first.release();
+  assertEqual(pool.available(), (size_t)1);
+  {
+    auto moved = std::move(second);
+    assertEqual((bool)second, false);
+    assertEqual(pool.available(), (size_t)1);
+  }
+  assertEqual(pool.available(), (size_t)2);
+}
+
+test(UnitTests, pool_shared_between_threads)
+{
+  LoopbackClient clients[2];
+  std::unique_ptr<Redis> redis[2];
+  for (int i = 0; i < 2; i++)
+  {
+    clients[i].script(":1\r\n");
+    clients[i].setRepeat(true);
+    redis[i].reset(new Redis(clients[i]));
+  }
+  RedisPool pool({redis[0].get(), redis[1].get()});
+
+  // more threads than connections, each issuing commands only on connections it has leased
+  std::atomic<int> published(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+  {
+    threads.emplace_back([&]()
+                         {
+      for (int i = 0; i < 200; i++)
+      {
+        auto lease = pool.acquire(1000);
+        if (lease)
+        {
+          published += lease->publish("c", "m");
+        }
+      } });
+  }
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  assertEqual(published.load(), 800);
+  assertEqual(clients[0].writeCalls() + clients[1].writeCalls(), (size_t)800);
+  assertEqual(pool.available(), (size_t)2);
+}
+
+// records each reply's RESP into the std::vector<std::string> context
+static void recordReply(Redis *, std::shared_ptr<RedisObject> reply, void *context)
+{
+  ((std::vector<std::string> *)context)->push_back(reply->RESP().c_str());
+}
+
+test(UnitTests, async_completes_in_order)
+{
+  std::vector<std::string> replies;
+  LoopbackClient client;
+  Redis redis(client);
+
+  assertEqual(redis.getAsync("a", recordReply, &replies), true);
+  assertEqual(redis.setAsync("b", "2", recordReply, &replies), true);
+  assertEqual(redis.issueAsync("HINCRBY", {"h", "f", "1"}, recordReply, &replies), true);
+  assertEqual(client.written().c_str(),
+              "*2\r\n$3\r\nGET\r\n$1\r\na\r\n*3\r\n$3\r\nSET\r\n$1\r\nb\r\n$1\r\n2\r\n"
+              "*4\r\n$7\r\nHINCRBY\r\n$1\r\nh\r\n$1\r\nf\r\n$1\r\n1\r\n");
+  assertEqual(redis.pending(), (size_t)3);
+
+  // nothing has arrived: polling returns at once
+  assertEqual(redis.poll(), (size_t)0);
+
+  // a reply is completed only once all of it has arrived
+  client.script("$1\r\n1\r\n+O");
+  assertEqual(redis.poll(), (size_t)1);
+  client.script("K\r\n:5\r\n");
+  assertEqual(redis.poll(), (size_t)2);
+  assertEqual(replies.size(), (size_t)3);
+  assertEqual(replies[0].c_str(), "$1\r\n1\r\n");
+  assertEqual(replies[1].c_str(), "+OK\r\n");
+  assertEqual(replies[2].c_str(), ":5\r\n");
+  assertEqual(redis.pending(), (size_t)0);
+}
+
+test(UnitTests, async_then_sync)
+{
+  std::vector<std::string> replies;
+  LoopbackClient client("$1\r\n1\r\n:1\r\n$1\r\n2\r\n");
+  Redis redis(client);
+
+  // a synchronous command reads the outstanding replies before its own
+  redis.getAsync("a", recordReply, &replies);
+  redis.publishAsync("c", "m");
+  assertEqual(redis.get("b").c_str(), "2");
+  assertEqual(replies.size(), (size_t)1);
+  assertEqual(replies[0].c_str(), "$1\r\n1\r\n");
+  assertEqual(redis.pending(), (size_t)0);
+
+  // replies outstanding when the connection is lost complete with an error
+  redis.getAsync("a", recordReply, &replies);
+  client.drop();
+  assertEqual(redis.poll(), (size_t)1);
+  assertEqual(replies.size(), (size_t)2);
+  assertEqual(replies[1].substr(0, 16).c_str(), "-INTERNAL ERROR ");
+  assertEqual(redis.getAsync("a", recordReply, &replies), false);
+}
+
+test(UnitTests, async_then_hooked)
+{
+  LoopbackClient client("$5\r\nfirst\r\n$6\r\nsecond\r\n$5\r\nthird\r\n*1\r\n*2\r\n$6\r\nstream\r\n" + xrange_vector);
+  Redis redis(client);
+  std::shared_ptr<RedisObject> kept;
+  auto keep = [](Redis *, std::shared_ptr<RedisObject> reply, void *context)
+  { *(std::shared_ptr<RedisObject> *)context = reply; };
+
+  // the outstanding reply is read into its own allocation, not the buffer given for the next
+  uint8_t buf[8];
+  redis.getAsync("a", keep, &kept);
+  assertEqual(redis.get("b", buf, sizeof(buf)), 6);
+  assertEqual(std::string((const char *)buf, 6).c_str(), "second");
+  assertEqual(kept->operator String().c_str(), "first");
+
+  // ... nor are its elements handed to the sink set for the next
+  streamedIds.clear();
+  redis.getAsync("c", keep, &kept);
+  auto count = redis.xread_entries(0, 0, "stream", "0",
+                                   [](Redis *, const RedisStreamEntry &entry)
+                                   { streamedIds.push_back(entry.id()); });
+  assertEqual(kept->operator String().c_str(), "third");
+  assertEqual(count, 2);
+  assertEqual(streamedIds.size(), (size_t)2);
+  assertEqual(streamedIds[1].c_str(), "2-0");
+}
+
+test(UnitTests, connection_fails_pending_replies)
+{
+  std::vector<std::string> replies;
+  LoopbackClient client("+OK\r\n");
+  RedisConnection connection(client, "redis.local");
+  connection.setPassword("pw");
+  Redis &redis = connection.redis();
+  assertEqual(connection.connect(), true);
+
+  // a reply outstanding when the connection is lost completes with an error, not with the new connection's
+  redis.getAsync("a", recordReply, &replies);
+  client.drop();
+  client.script("+OK\r\n");
+  assertEqual(connection.maintain(), true);
+  assertEqual(replies.size(), (size_t)1);
+  assertEqual(replies[0].substr(0, 16).c_str(), "-INTERNAL ERROR ");
+  assertEqual(redis.pending(), (size_t)0);
+}
+
+test(UnitTests, transaction_commits)
+{
+  LoopbackClient client("+OK\r\n+QUEUED\r\n+QUEUED\r\n+QUEUED\r\n*3\r\n:1\r\n$3\r\n1-0\r\n-WRONGTYPE not a hash\r\n");
+  // acknowledgements split across reads are skipped all the same
+  client.setChunkSize(4);
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  auto hset = tx.queue({"HSET", "device", "state", "on"});
+  auto xadd = tx.queue({"XADD", "events", "*", "state", "on"});
+  auto bad = tx.queue("HGET", {"events", "state"});
+  assertEqual(tx.size(), (size_t)3);
+  assertEqual(tx.exec(), RedisTransactionCommitted);
+
+  // MULTI, the commands and EXEC in a single write
+  assertEqual(client.writeCalls(), (size_t)1);
+  assertEqual(client.written().substr(0, 15).c_str(), "*1\r\n$5\r\nMULTI\r\n");
+  assertEqual(client.written().substr(client.written().size() - 14).c_str(), "*1\r\n$4\r\nEXEC\r\n");
+
+  assertEqual(tx.reply_typed<int>(hset), 1);
+  assertEqual(tx.reply_typed<String>(xadd).c_str(), "1-0");
+  assertEqual(tx.reply(bad)->type(), RedisObject::Type::Error);
+}
+
+test(UnitTests, transaction_watch_aborts)
+{
+  LoopbackClient client("+OK\r\n+OK\r\n+QUEUED\r\n*-1\r\n");
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  assertEqual(tx.watch({"lease"}), true);
+  auto slot = tx.queue({"EXPIRE", "lease", "30"});
+  assertEqual(tx.exec(), RedisTransactionAborted);
+  assertEqual(tx.reply(slot) == nullptr, true);
+
+  // reused, the transaction starts over
+  client.clearWritten();
+  client.script("+OK\r\n+QUEUED\r\n*1\r\n:1\r\n");
+  slot = tx.queue({"EXPIRE", "lease", "30"});
+  assertEqual(tx.exec(), RedisTransactionCommitted);
+  assertEqual(tx.reply_typed<int>(slot), 1);
+  assertEqual(client.written().c_str(), "*1\r\n$5\r\nMULTI\r\n*3\r\n$6\r\nEXPIRE\r\n$5\r\nlease\r\n$2\r\n30\r\n*1\r\n$4\r\nEXEC\r\n");
+}
+
+test(UnitTests, transaction_refused)
+{
+  LoopbackClient client("+OK\r\n-ERR wrong number of arguments\r\n+QUEUED\r\n-EXECABORT Transaction discarded\r\n");
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  auto first = tx.queue({"HSET", "device"});
+  auto second = tx.queue({"XADD", "events", "*", "state", "on"});
+  assertEqual(tx.exec(), RedisTransactionFailed);
+  assertEqual(((String)*tx.reply(first)).c_str(), "ERR wrong number of arguments");
+  assertEqual(((String)*tx.reply(second)).c_str(), "EXECABORT Transaction discarded");
+  assertEqual(client.available(), 0);
+}
+
+test(UnitTests, transaction_slow_server)
+{
+  // each reply arrives in a chunk of its own, 200ms after the last, twice the timeout
+  LoopbackClient client("+OK_123\r\n+QUEUED\r\n*1\r\n:2\r\n");
+  client.setChunkSize(9);
+  client.setLatency(200000);
+  client.setTimeout(100);
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  // an acknowledgement yet to begin arriving hasn't timed out
+  auto slot = tx.queue({"INCR", "a"});
+  assertEqual(tx.exec(), RedisTransactionCommitted);
+  assertEqual(tx.reply_typed<int>(slot), 2);
+}
+
+test(UnitTests, transaction_timed_out)
+{
+  LoopbackClient client("+OK\r\n+QUE");
+  client.setTimeout(50);
+  Redis redis(client);
+  RedisTransaction tx(redis);
+
+  // the rest of the acknowledgement, and EXEC's reply, can't be told apart from later replies: the
+  // connection is closed rather than left for the next command to misread
+  auto slot = tx.queue({"INCR", "a"});
+  assertEqual(tx.exec(), RedisTransactionFailed);
+  assertEqual(tx.reply(slot)->type(), RedisObject::Type::InternalError);
+  assertEqual(client.connected(), (uint8_t)0);
+
+  client.script("+QUEUED\r\n+OK\r\n");
+  assertEqual(redis.set("k", "v"), false);
+}
+
+test(UnitTests, script_sha1)
+{
+  RedisScript returnOne("return 1");
+  assertEqual(returnOne.sha(), "e0e1f9fabfc9d4800c877a703b823ac0578ff8db");
+
+  // bodies either side of a SHA1 block boundary, and spanning several blocks
+  static const std::string a55(55, 'a'), a56(56, 'a'), a1000(1000, 'a');
+  RedisScript s55(a55.c_str()), s56(a56.c_str()), s1000(a1000.c_str());
+  assertEqual(s55.sha(), "c1c8bbdc22796e28c0e15163d20899b65621d65a");
+  assertEqual(s56.sha(), "c2db330f6083854c99d4b5bfb6e8f29f201be699");
+  assertEqual(s1000.sha(), "291e9a6c66994949b57ba5e650361e98fc36b1ba");
+}
+
+test(UnitTests, script_noscript_fallback)
+{
+  LoopbackClient client("-NOSCRIPT No matching script. Please use EVAL.\r\n"
+                        "$40\r\ne0e1f9fabfc9d4800c877a703b823ac0578ff8db\r\n:1\r\n");
+  Redis redis(client);
+  RedisScript returnOne("return 1");
+
+  // loaded upon NOSCRIPT, then retried
+  assertEqual(returnOne.run_typed<int>(redis, {"k"}, {"v"}), 1);
+  const std::string evalsha = "*5\r\n$7\r\nEVALSHA\r\n$40\r\ne0e1f9fabfc9d4800c877a703b823ac0578ff8db\r\n"
+                              "$1\r\n1\r\n$1\r\nk\r\n$1\r\nv\r\n";
+  assertEqual(client.written(), evalsha + "*3\r\n$6\r\nSCRIPT\r\n$4\r\nLOAD\r\n$8\r\nreturn 1\r\n" + evalsha);
+
+  // and thereafter the body is never sent
+  client.clearWritten();
+  client.script(":1\r\n");
+  assertEqual(returnOne.run_typed<int>(redis, {"k"}, {"v"}), 1);
+  assertEqual(client.written(), evalsha);
+
+  // a function is called by name through the same interface
+  client.clearWritten();
+  client.script("$2\r\nok\r\n");
+  RedisFunction fn("set_if_higher", true);
+  assertEqual(fn.run_typed<String>(redis, {"temp:max"}, {"23"}).c_str(), "ok");
+  assertEqual(client.written().c_str(), "*5\r\n$8\r\nFCALL_RO\r\n$13\r\nset_if_higher\r\n$1\r\n1\r\n$8\r\ntemp:max\r\n$2\r\n23\r\n");
+}
+
+test(UnitTests, scan_pages)
+{
+  // an empty page (all filtered out by MATCH) is skipped over
+  LoopbackClient client("*2\r\n$2\r\n17\r\n*2\r\n$3\r\ns:1\r\n$3\r\ns:2\r\n"
+                        "*2\r\n$2\r\n42\r\n*0\r\n"
+                        "*2\r\n$1\r\n0\r\n*1\r\n$3\r\ns:3\r\n");
+  Redis redis(client);
+  RedisScan scan(redis);
+  scan.setMatch("s:*");
+  scan.setCount(2);
+
+  std::vector<String> keys;
+  String key;
+  while (scan.next(key))
+  {
+    keys.push_back(key);
+  }
+  assertEqual(keys.size(), (size_t)3);
+  assertEqual(keys[2].c_str(), "s:3");
+  assertEqual(scan.error() == nullptr, true);
+  assertEqual(client.written().c_str(),
+              "*6\r\n$4\r\nSCAN\r\n$1\r\n0\r\n$5\r\nMATCH\r\n$3\r\ns:*\r\n$5\r\nCOUNT\r\n$1\r\n2\r\n"
+              "*6\r\n$4\r\nSCAN\r\n$2\r\n17\r\n$5\r\nMATCH\r\n$3\r\ns:*\r\n$5\r\nCOUNT\r\n$1\r\n2\r\n"
+              "*6\r\n$4\r\nSCAN\r\n$2\r\n42\r\n$5\r\nMATCH\r\n$3\r\ns:*\r\n$5\r\nCOUNT\r\n$1\r\n2\r\n");
+
+  // an error ends the walk, and is kept
+  client.script("-WRONGTYPE Operation against a key holding the wrong kind of value\r\n");
+  RedisScan fields(redis, RedisScanHash, "s:1");
+  String field, value;
+  assertEqual(fields.next(field, value), false);
+  assertEqual(fields.error()->type(), RedisObject::Type::Error);
+}
+
+test(UnitTests, scan_prefetch)
+{
+  LoopbackClient client("*2\r\n$1\r\n5\r\n*4\r\n$1\r\na\r\n$1\r\n1\r\n$1\r\nb\r\n$1\r\n2\r\n");
+  Redis redis(client);
+  RedisScan scan(redis, RedisScanHash, "h");
+  scan.setPrefetch(true);
+
+  String field, value;
+  assertEqual(scan.next(field, value), true);
+  assertEqual(field.c_str(), "a");
+  assertEqual(value.c_str(), "1");
+
+  // the next page was requested as soon as the first arrived
+  const char *first = "*3\r\n$5\r\nHSCAN\r\n$1\r\nh\r\n$1\r\n0\r\n";
+  assertEqual(client.written().c_str(), (std::string(first) + "*3\r\n$5\r\nHSCAN\r\n$1\r\nh\r\n$1\r\n5\r\n").c_str());
+  assertEqual(redis.pending(), (size_t)1);
+
+  // a command issued meanwhile reads the page ahead of its own reply
+  client.script("*2\r\n$1\r\n0\r\n*2\r\n$1\r\nc\r\n$1\r\n3\r\n$2\r\nok\r\n");
+  assertEqual(redis.get("k").c_str(), "ok");
+  assertEqual(redis.pending(), (size_t)0);
+
+  assertEqual(scan.next(field, value), true);
+  assertEqual(field.c_str(), "b");
+  assertEqual(scan.next(field, value), true);
+  assertEqual(field.c_str(), "c");
+  assertEqual(value.c_str(), "3");
+  assertEqual(scan.next(field, value), false);
+  assertEqual(scan.error() == nullptr, true);
+}
+
+test(UnitTests, zset_scored_members)
+{
+  LoopbackClient client(":2\r\n"
+                        "*4\r\n$1\r\nb\r\n$3\r\n2.5\r\n$1\r\nc\r\n$4\r\n1e+3\r\n"
+                        "*1\r\n*2\r\n$1\r\na\r\n,1\r\n"
+                        "*-1\r\n");
+  Redis redis(client);
+
+  assertEqual(redis.zadd("z", {{"a", 1}, {"b", 2.5}, {"c", 0.1}}, "NX"), 2);
+  assertEqual(client.written().c_str(),
+              "*9\r\n$4\r\nZADD\r\n$1\r\nz\r\n$2\r\nNX\r\n$1\r\n1\r\n$1\r\na\r\n$3\r\n2.5\r\n$1\r\nb\r\n$3\r\n0.1\r\n$1\r\nc\r\n");
+
+  // RESP2 alternates members and scores
+  client.clearWritten();
+  auto members = redis.zrange("z", "(1", "+inf", RedisZRangeByScore, false, 0, 10);
+  assertEqual(client.written().c_str(),
+              "*9\r\n$6\r\nZRANGE\r\n$1\r\nz\r\n$2\r\n(1\r\n$4\r\n+inf\r\n$7\r\nBYSCORE\r\n"
+              "$5\r\nLIMIT\r\n$1\r\n0\r\n$2\r\n10\r\n$10\r\nWITHSCORES\r\n");
+  assertEqual(members.size(), (size_t)2);
+  assertEqual(members[0].member.c_str(), "b");
+  assertEqual(members[0].score, 2.5);
+  assertEqual(members[1].score, 1000.0);
+
+  // RESP3 nests each member with its score
+  members = redis.zpopmin("z");
+  assertEqual(members.size(), (size_t)1);
+  assertEqual(members[0].member.c_str(), "a");
+  assertEqual(members[0].score, 1.0);
+
+  // BZPOPMIN timed out
+  RedisScoredMember popped;
+  assertEqual(redis.bzpopmin({"z"}, 0.5, popped), false);
+}
+
+test(UnitTests, typed_results)
+{
+  TestDirectClient client(":4294967296\r\n$2\r\n42\r\n$2\r\n4x\r\n,2.5e3\r\n$-1\r\n-WRONGTYPE x\r\n*0\r\n#t\r\n");
+  RedisReader reader(client);
+
+  // an integer beyond an int is kept whole, and only refused as an int
+  auto big = RedisObject::parseType(reader);
+  assertEqual((long long)RedisCommand::convert_result<int64_t>(big).value, 4294967296LL);
+  assertEqual(RedisCommand::convert_result<int>(big).status, RedisResultOutOfRange);
+
+  // numbers as text (as GET returns them), and RESP3 doubles
+  assertEqual((long long)RedisCommand::convert_result<int64_t>(RedisObject::parseType(reader)).value, 42LL);
+  auto text = RedisObject::parseType(reader);
+  assertEqual(RedisCommand::convert_result<int64_t>(text).status, RedisResultWrongType);
+  assertEqual(RedisCommand::convert_result<double>(text).status, RedisResultWrongType);
+  assertEqual(RedisCommand::convert_result<String>(text).value.c_str(), "4x");
+  assertEqual(RedisCommand::convert_result<double>(RedisObject::parseType(reader)).value, 2500.0);
+
+  // no value doubles as an error
+  assertEqual(RedisCommand::convert_result<int>(RedisObject::parseType(reader)).status, RedisResultNil);
+  auto refused = RedisCommand::convert_result<int64_t>(RedisObject::parseType(reader));
+  assertEqual(refused.status, RedisResultError);
+  assertEqual(refused.error->operator String().c_str(), "WRONGTYPE x");
+  assertEqual(RedisCommand::convert_result<String>(RedisObject::parseType(reader)).status, RedisResultWrongType);
+  assertEqual(RedisCommand::convert_result<bool>(RedisObject::parseType(reader)).value, true);
+  assertEqual(RedisCommand::convert_result<int>(nullptr).status, RedisResultInternalError);
+}
+
+test(UnitTests, malformed_numbers)
+{
+  TestDirectClient client(":12x\r\n:9223372036854775808\r\n,0.1\r\n,-inf\r\n,1.5.2\r\n*2\r\n:1\r\n:\r\n:-9223372036854775808\r\n");
+  RedisReader reader(client);
+
+  // a malformed or out-of-range integer isn't taken for 0
+  for (auto i = 0; i < 2; i++)
+  {
+    auto bad = RedisObject::parseType(reader);
+    assertEqual(bad->type(), RedisObject::Type::InternalError);
+    assertEqual(((RedisInternalError *)bad.get())->code(), RedisInternalError::MalformedReply);
+    assertEqual(RedisCommand::convert_result<int64_t>(bad).status, RedisResultInternalError);
+  }
+
+  // RESP3 doubles are parsed as they arrive, and still read as text
+  auto tenth = RedisObject::parseType(reader);
+  assertEqual(tenth->type(), RedisObject::Type::SimpleString);
+  assertEqual(tenth->wireType(), RedisObject::Type::Double);
+  assertEqual(((RedisDouble *)tenth.get())->value(), 0.1);
+  assertEqual(tenth->operator String().c_str(), "0.1");
+  assertEqual(RedisCommand::convert_result<double>(RedisObject::parseType(reader)).value, -INFINITY);
+  assertEqual(RedisObject::parseType(reader)->type(), RedisObject::Type::InternalError);
+
+  // within an array, the element alone is an error, and the replies that follow are unaffected
+  auto pair = RedisObject::parseType(reader);
+  assertEqual(pair->type(), RedisObject::Type::Array);
+  assertEqual(((RedisArray *)pair.get())->size(), (size_t)2);
+  assertEqual(((RedisArray *)pair.get())->at(0)->type(), RedisObject::Type::Integer);
+  assertEqual(((RedisArray *)pair.get())->at(1)->type(), RedisObject::Type::InternalError);
+  auto least = RedisCommand::convert_result<int64_t>(RedisObject::parseType(reader));
+  assertEqual(least.ok(), true);
+  assertEqual((long long)least.value, (long long)INT64_MIN);
+}
+
+test(UnitTests, incr_64_bit)
+{
+  LoopbackClient client(":3000000000\r\n,0.30000000000000004\r\n-ERR value is not an integer or out of range\r\n"
+                        ":2592000000\r\n-WRONGTYPE Operation against a key holding the wrong kind of value\r\n");
+  Redis redis(client);
+
+  auto count = redis.incr("boots", 3000000000LL);
+  assertEqual(count.ok(), true);
+  assertEqual((long long)count.value, 3000000000LL);
+  assertEqual(redis.incrbyfloat("f", 0.1).value, 0.30000000000000004);
+  assertEqual(client.written().c_str(),
+              "*3\r\n$6\r\nINCRBY\r\n$5\r\nboots\r\n$10\r\n3000000000\r\n"
+              "*3\r\n$11\r\nINCRBYFLOAT\r\n$1\r\nf\r\n$3\r\n0.1\r\n");
+
+  auto refused = redis.incr("f");
+  assertEqual(refused.status, RedisResultError);
+  assertEqual(refused.value == 0, true);
+
+  // a TTL of 30 days, in milliseconds; and a failure, told apart from any TTL
+  assertEqual((long long)redis.pttl("lease"), 2592000000LL);
+  assertEqual(redis.pttlResult("lease").status, RedisResultError);
+}